@@ -21,6 +21,8 @@
 #define SEGMENT_LEN FIRST_LV_LEN
 #define PAGE_LEN SECOND_LV_LEN
 
+#define NUM_REGS 10
+
 #define NUM_PAGES (1 << (ADDRESS_SIZE - OFFSET_LEN))
 #define PAGE_SIZE (1 << OFFSET_LEN)
 
@@ -67,10 +69,26 @@ struct inst_t
 	arg_t arg_3;
 };
 
+/* Pre-decoded instruction executed by the threaded interpreter, the
+ * handler points straight at the code implementing the opcode */
+struct dinst_t
+{
+	const void *handler;
+	arg_t arg_0;
+	arg_t arg_1;
+	arg_t arg_2;
+	arg_t arg_3;
+};
+
 struct code_seg_t
 {
 	struct inst_t *text;
+	struct dinst_t *dtext; // text pre-decoded by cpu_decode(), size + 1 entries
 	uint32_t size;
+	void *map_base;	       // mapped image holding [text], NULL if malloc'ed
+	size_t map_len;
+	uint32_t priority;     // default priority recorded in the program
+	struct code_cache_t *cache; // loader cache entry sharing this segment
 };
 
 struct trans_table_t
@@ -103,7 +121,7 @@ struct pcb_t
 	uint32_t priority;	 // Default priority, this legacy process based (FIXED)
 	char path[100];
 	struct code_seg_t *code; // Code segment
-	addr_t regs[10];	 // Registers, store address of allocated regions
+	addr_t regs[NUM_REGS];	 // Registers, store address of allocated regions
 	uint32_t pc;		 // Program pointer, point to the next instruction
 #ifdef MLQ_SCHED
 	// Priority on execution (if supported), on-fly aka. changeable
@@ -113,13 +131,19 @@ struct pcb_t
 	struct krnl_t *krnl;	
 	struct page_table_t *page_table; // Page table
 	uint32_t bp;			 // Break pointer
+	uint64_t arrival_time;		 // Slot the process was admitted in
+	uint64_t first_run;		 // Slot of its first dispatch
+	/* Intrusive links of the process list the PCB is on (see queue.h) */
+	struct pcb_t *q_prev;
+	struct pcb_t *q_next;
+	struct proc_list_t *q_list;	 // list holding the PCB, NULL if none
 };
 
 /* Kernel structure */
 struct krnl_t
 {
-	struct queue_t *ready_queue;
-	struct queue_t *running_list;
+	struct prio_queue_t *ready_queue;
+	struct proc_list_t *running_list;
 #ifdef MLQ_SCHED
 	struct queue_t *mlq_ready_queue;
 #endif
@@ -9,5 +9,16 @@
  * Otherwise, return 1. */
 int run(struct pcb_t * proc);
 
+/* Translate [code->text] into the threaded form run by run().
+ * Return 0 on success, -1 if out of memory. */
+int cpu_decode(struct code_seg_t * code);
+
+/* Bind the calling thread to simulated CPU [id]. Threads that are
+ * not CPUs (loader, timer) are never bound and report -1. */
+void cpu_set_current(int id);
+
+/* Return the simulated CPU the calling thread runs as, or -1 */
+int cpu_current(void);
+
 #endif
 
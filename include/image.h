@@ -0,0 +1,54 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "common.h"
+
+/*
+ * Process images
+ *
+ * A process is described either by the text format (a "priority size"
+ * header followed by one instruction per line, '#' starts a comment)
+ * or by a compiled binary image produced offline by mkimage:
+ *
+ *   struct pimg_header_t    header
+ *   instruction[size]       text, at text_off
+ *
+ * Instructions are fixed-width records laid out like struct inst_t of
+ * the build that wrote them (inst_size / arg_size, host byte order).
+ * When the layout matches the running build the loader maps the image
+ * and executes the text in place; otherwise it is converted on load.
+ */
+
+#define PIMG_MAGIC	0x474d4950	/* "PIMG" */
+#define PIMG_VERSION	1
+
+struct pimg_header_t {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t inst_size;	/* bytes per instruction record */
+	uint16_t arg_size;	/* bytes per argument in a record */
+	uint16_t reserved;
+	uint32_t priority;	/* default priority of the process */
+	uint32_t size;		/* number of instructions */
+	uint32_t text_off;	/* file offset of the first instruction */
+};
+
+/* Parse a text description from [file] into [code]. [path] is only
+ * used in messages. Return 0, or -1 on a malformed description. */
+int image_parse_text(FILE *file, const char *path,
+		     uint32_t *priority, struct code_seg_t *code);
+
+/* Write [code] to [file] as a compiled image. Return 0 or -1. */
+int image_write(FILE *file, uint32_t priority,
+		const struct code_seg_t *code);
+
+/* Load the compiled image at [path] into [code], mapping it when it
+ * can run in place. Return 0 on success, 1 if [path] is not a compiled
+ * image, -1 on a damaged or unreadable image. */
+int image_map(const char *path, uint32_t *priority,
+	      struct code_seg_t *code);
+
+/* Release the text of [code] set up by image_parse_text/image_map */
+void image_unmap(struct code_seg_t *code);
+
+#endif
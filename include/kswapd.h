@@ -0,0 +1,47 @@
+#ifndef KSWAPD_H
+#define KSWAPD_H
+
+#include "common.h"
+
+/*
+ * Background page-out daemon
+ *
+ * Keeps the number of free MEMRAM frames between two watermarks, so
+ * the fault path on CPU threads usually finds a free frame instead of
+ * paging a victim out inline. Allocating a frame that leaves fewer
+ * than [low] free wakes the daemon. At the end of that time slot,
+ * while every device waits on the tick barrier, it pages cold pages
+ * out (as chosen by each mm's replacement policy, round robin across
+ * processes) until [high] frames are free. Running on simulated time
+ * rather than host time keeps the paging stats of a run repeatable.
+ * Watermarks are KSWAPD_LOW_PCT and KSWAPD_HIGH_PCT of MEMRAM, see
+ * os-cfg.h.
+ *
+ * If a slot uses up more than the free reserve, the fault path still
+ * reclaims directly.
+ */
+
+#ifndef KSWAPD_LOW_PCT
+#define KSWAPD_LOW_PCT 5
+#endif
+
+#ifndef KSWAPD_HIGH_PCT
+#define KSWAPD_HIGH_PCT 10
+#endif
+
+/* Pages reclaimed per hold of the paging lock */
+#ifndef KSWAPD_BATCH
+#define KSWAPD_BATCH 8
+#endif
+
+/* Start reclaiming for [mram] */
+int kswapd_start(struct memphy_struct * mram);
+
+/* Stop reclaiming, call once every device has detached */
+void kswapd_stop(void);
+
+/* Wake the daemon if [mram] is below its low watermark. Cheap enough
+ * to call after every frame allocation. */
+void kswapd_wakeup(struct memphy_struct * mram);
+
+#endif
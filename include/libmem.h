@@ -21,3 +21,8 @@ int liballoc(struct pcb_t *, addr_t, uint32_t);
 int libfree(struct pcb_t *, uint32_t);
 int libread(struct pcb_t*, uint32_t, addr_t, uint32_t*);
 int libwrite(struct pcb_t*, BYTE, uint32_t, addr_t);
+
+/* Page reclaim across processes, see kswapd.h */
+void pg_reclaim_add(struct pcb_t *proc);
+int pg_reclaim(struct memphy_struct *mram, int nr);
+int free_pcb_memph(struct pcb_t *caller);
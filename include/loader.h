@@ -2,8 +2,26 @@
 #define LOADER_H
 
 #include "common.h"
+#include "workload.h"
 
+/* Create a process from the text description or compiled image at
+ * [path]. Return NULL if it cannot be read. */
 struct pcb_t * load(const char * path);
 
-#endif
+/* Release a process created by load(), its code segment is freed
+ * along with the last process sharing it */
+void unload(struct pcb_t * proc);
+
+/* Load the arrivals of [wl] in the background with [nthreads]
+ * threads, staying at most [window] arrivals ahead of preload_take() */
+int preload_start(struct workload_t * wl, int nthreads, int window);
+
+/* Wait for the next arrival and return it in [arr] and [proc] as
+ * load() would, [proc] being NULL if it could not be loaded. PIDs are
+ * given here, in arrival order. Return 0 once the workload has ended. */
+int preload_take(struct wl_arrival_t * arr, struct pcb_t ** proc);
 
+/* Join the preload threads and release entries never taken */
+void preload_stop(void);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include "common.h"
+
+/*
+ * LZ77 codec for pages
+ *
+ * A small byte-oriented LZ in the style of LZ4: greedy matching through
+ * a hash of 4-byte sequences, no entropy coding. It trades ratio for
+ * speed, which is what a page going out to the compressed swap pool
+ * needs.
+ */
+
+/* Compress [n] bytes of [src] into [dst]. Return the compressed size,
+ * -1 if it would not fit in [cap] bytes. */
+int lz_compress(const BYTE * src, int n, BYTE * dst, int cap);
+
+/* Decompress [n] bytes of [src] into [dst]. Return the decompressed
+ * size, -1 if the stream is corrupt or would overflow [cap] bytes. */
+int lz_decompress(const BYTE * src, int n, BYTE * dst, int cap);
+
+#endif
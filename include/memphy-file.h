@@ -0,0 +1,40 @@
+#ifndef MEMPHY_FILE_H
+#define MEMPHY_FILE_H
+
+#include "common.h"
+
+/*
+ * Host-file backend of MEMPHY
+ *
+ * A device created by init_memphy_file() keeps its content in a host
+ * file instead of a malloc'd array, so it may be far larger than host
+ * memory. Only whole-frame accesses are supported, which is all swap
+ * needs.
+ *
+ * Writes are queued and carried out by an I/O thread of the device
+ * with pwrite, so the simulation does not wait for them. Reads are
+ * synchronous; they see queued writes that have not reached the file
+ * yet. At most MEMPHY_IO_DEPTH writes are queued per device, further
+ * submitters wait.
+ */
+
+#ifndef MEMPHY_IO_DEPTH
+#define MEMPHY_IO_DEPTH 64
+#endif
+
+/* Back [mp] with a new file named [path] plus a unique suffix */
+int memphy_file_open(struct memphy_struct * mp, const char * path);
+
+/* Read [len] bytes at [off] */
+int memphy_file_read(struct memphy_struct * mp, addr_t off,
+		     BYTE * buf, addr_t len);
+
+/* Queue a write of [len] bytes at [off]. The queue takes [buf], a
+ * malloc'd buffer, and frees it once written. */
+int memphy_file_submit(struct memphy_struct * mp, addr_t off,
+		       BYTE * buf, addr_t len);
+
+/* Wait until every queued write is in the file */
+void memphy_file_sync(struct memphy_struct * mp);
+
+#endif
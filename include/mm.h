@@ -17,7 +17,7 @@
 /* PTE BIT */
 #define PAGING_PTE_PRESENT_MASK BIT(31) 
 #define PAGING_PTE_SWAPPED_MASK BIT(30)
-#define PAGING_PTE_RESERVE_MASK BIT(29)
+#define PAGING_PTE_ACCESSED_MASK BIT(29) /* set on translation, cleared by replacement */
 #define PAGING_PTE_DIRTY_MASK BIT(28)
 #define PAGING_PTE_EMPTY01_MASK BIT(14)
 #define PAGING_PTE_EMPTY02_MASK BIT(13)
@@ -115,6 +115,9 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn);
 int pte_set_swap(struct pcb_t *caller, addr_t pgn, int swptyp, addr_t swpoff);
 uint32_t pte_get_entry(struct pcb_t *caller, addr_t pgn);
 int pte_set_entry(struct pcb_t *caller, addr_t pgn, uint32_t pte_val);
+int pte_set_accessed(struct pcb_t *caller, addr_t pgn, int accessed);
+int pte_set_dirty(struct pcb_t *caller, addr_t pgn, int dirty);
+int free_pgtbl(struct pcb_t *caller);
 int init_pte(addr_t *pte,
              int pre,    // present
              addr_t fpn,    // FPN
@@ -146,7 +149,7 @@ struct vm_rg_struct * get_symrg_byid(struct mm_struct* mm, int rgid);
 int validate_overlap_vm_area(struct pcb_t *caller, int vmaid, addr_t vmastart, addr_t vmaend);
 int get_free_vmrg_area(struct pcb_t *caller, int vmaid, int size, struct vm_rg_struct *newrg);
 int inc_vma_limit(struct pcb_t *caller, int vmaid, addr_t inc_sz);
-int find_victim_page(struct mm_struct* mm, addr_t *pgn);
+int find_victim_page(struct pcb_t *caller, addr_t *pgn);
 struct vm_area_struct *get_vma_by_num(struct mm_struct *mm, int vmaid);
 
 /* MEM/PHY protypes */
@@ -154,8 +157,34 @@ int MEMPHY_get_freefp(struct memphy_struct *mp, addr_t *fpn);
 int MEMPHY_put_freefp(struct memphy_struct *mp, addr_t fpn);
 int MEMPHY_read(struct memphy_struct * mp, addr_t addr, BYTE *value);
 int MEMPHY_write(struct memphy_struct * mp, addr_t addr, BYTE data);
+int MEMPHY_read32(struct memphy_struct *mp, addr_t addr, uint32_t *value);
+int MEMPHY_write32(struct memphy_struct *mp, addr_t addr, uint32_t value);
+int MEMPHY_read64(struct memphy_struct *mp, addr_t addr, uint64_t *value);
+int MEMPHY_write64(struct memphy_struct *mp, addr_t addr, uint64_t value);
+int MEMPHY_read_frame(struct memphy_struct *mp, addr_t fpn, BYTE *buf);
+int MEMPHY_write_frame(struct memphy_struct *mp, addr_t fpn, const BYTE *buf);
+int MEMPHY_zero_frame(struct memphy_struct *mp, addr_t fpn);
+int MEMPHY_copy_frame(struct memphy_struct *mpsrc, addr_t srcfpn,
+                      struct memphy_struct *mpdst, addr_t dstfpn);
+/* Swap slots handed out together, a power of two of at most 64 */
+#ifndef SWAP_CLUSTER
+#define SWAP_CLUSTER 16
+#endif
+/* Simulated head movement of a sequential device */
+#ifndef MEMPHY_SEEK_SETTLE_NS
+#define MEMPHY_SEEK_SETTLE_NS 2000
+#endif
+#ifndef MEMPHY_SEEK_NS_PER_KB
+#define MEMPHY_SEEK_NS_PER_KB 10
+#endif
+int MEMPHY_gather_frames(struct memphy_struct *mpsrc, const addr_t *srcfpn,
+                         int n, struct memphy_struct *mpdst, addr_t dstfpn);
+int MEMPHY_get_cluster(struct memphy_struct *mp, int n, addr_t *fpn);
 int MEMPHY_dump(struct memphy_struct * mp);
 int init_memphy(struct memphy_struct *mp, addr_t max_size, int randomflg);
+int init_memphy_file(struct memphy_struct *mp, addr_t max_size,
+                     const char *path);
+void MEMPHY_sync(struct memphy_struct *mp);
 
 /* print list */
 int print_list_fp(struct framephy_struct *fp);
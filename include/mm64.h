@@ -12,6 +12,13 @@
 #define GENMASK64(h, l) \
 	(((~0ULL) << (l)) & (~0ULL >> (MM64_BITS_PER_LONG  - (h) - 1)))
 
+#define PAGING64_LEVELS  5         /* PGD, P4D, PUD, PMD, PT */
+#define PAGING64_PTRS_PER_TBL 512  /* 9 index bits per level */
+
+/* Page number and in-page offset of a virtual address */
+#define PAGING64_PGN(addr)    ((addr) >> PAGING64_ADDR_PT_SHIFT)
+#define PAGING64_OFFST(addr)  ((addr) & (PAGING64_PAGESZ - 1))
+
 #define PAGING64_MAX_PGN  (DIV_ROUND_UP(BIT_ULL(21),PAGING64_PAGESZ))
 #define PAGING64_PAGE_ALIGNSZ(sz) (DIV_ROUND_UP(sz,PAGING64_PAGESZ)*PAGING64_PAGESZ)
 
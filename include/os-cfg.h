@@ -16,6 +16,44 @@
 
 #define MM_PAGING
 #define MM_FIXED_MEMSZ
+
+/* Per-CPU software TLB in front of the 5-level page walk */
+#define MM_TLB 1
+#define TLB_NUM_SETS 16		/* must be a power of two */
+#define TLB_NUM_WAYS 4
+/* Default page replacement policy: fifo, clock, 2q or arc (os -p) */
+#define PG_REPL_POLICY "fifo"
+/* Page-out daemon keeping the free MEMRAM frames between these
+ * percentages of RAM, run at the end of each time slot */
+#define MM_KSWAPD 1
+#define KSWAPD_LOW_PCT 5
+#define KSWAPD_HIGH_PCT 10
+/* Size in bytes of the compressed pool that evicted dirty pages go to
+ * before MEMSWP */
+#define MM_ZSWAP 1
+#define ZSWAP_POOL_SIZE (1 << 20)
+/* MEMPHY storage is mapped on demand; prefault it all at boot, and/or
+ * ask the host for transparent huge pages */
+//#define MEMPHY_POPULATE 1
+//#define MEMPHY_HUGEPAGE 1
+/* Keep each MEMSWP device in a host file instead of host memory, named
+ * by this pattern with the device index and a unique suffix */
+//#define MM_SWAP_FILE "/tmp/memswp%d"
+/* Make MEMSWP a sequential access device, seek costs are reported in
+ * the seek_* stats */
+//#define MM_SWAP_SEQ 1
+/* Swap slots are handed out in aligned runs of this many, so pages
+ * reclaimed together are written to swap in one transfer */
+#define SWAP_CLUSTER 16
+
+/* Polls of the tick barrier before a device sleeps on it */
+#define TIMER_SPIN_COUNT 1000
+/* Skip slots in which every CPU is idle, up to the next arrival */
+//#define TIMER_EVENT_DRIVEN 1
+/* Threads loading programs ahead of their start time, and how many
+ * programs past the next arrival they may get ahead */
+#define LOADER_THREADS 4
+#define LOADER_WINDOW 64
 //#define VMDBG 1
 //#define MMDBG 1
 #define IODUMP 1
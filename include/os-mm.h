@@ -62,7 +62,22 @@ struct paging_stats {
     unsigned long page_faults;  /* total page faults */
     unsigned long swap_in;      /* number of swap-in operations */
     unsigned long swap_out;     /* number of swap-out operations */
+    unsigned long swap_writes;  /* swap device writes, a batch is one */
+    unsigned long swap_io_bytes; /* bytes moved to/from swap files */
+    unsigned long swap_io_usec; /* time spent in swap file I/O */
+    unsigned long seek_count;   /* cursor moves on sequential devices */
+    unsigned long seek_bytes;   /* total distance of those moves */
+    unsigned long seek_nsec;    /* simulated time of those moves */
     size_t        pt_bytes;     /* total bytes used by page tables */
+    unsigned long tlb_hit;      /* translations served by a CPU's TLB */
+    unsigned long tlb_miss;     /* translations that needed a page walk */
+    unsigned long tlb_flush;    /* TLB entries dropped by invalidation */
+    unsigned long kswapd_reclaim; /* pages paged out by kswapd */
+    unsigned long direct_reclaim; /* pages paged out on the fault path */
+    unsigned long evict_clean;  /* evictions that needed no page copy */
+    unsigned long zswap_stored; /* pages compressed into the zswap pool */
+    unsigned long zswap_same_filled; /* pages pooled as one repeated word */
+    unsigned long zswap_reject; /* pages the pool did not take */
 };
 
 /* Defined exactly once in src/os-mm.c */
@@ -75,7 +90,22 @@ static inline void paging_stats_reset(void)
     g_paging_stats.page_faults = 0;
     g_paging_stats.swap_in     = 0;
     g_paging_stats.swap_out    = 0;
+    g_paging_stats.swap_writes = 0;
+    g_paging_stats.swap_io_bytes = 0;
+    g_paging_stats.swap_io_usec = 0;
+    g_paging_stats.seek_count  = 0;
+    g_paging_stats.seek_bytes  = 0;
+    g_paging_stats.seek_nsec   = 0;
     g_paging_stats.pt_bytes    = 0;
+    g_paging_stats.tlb_hit     = 0;
+    g_paging_stats.tlb_miss    = 0;
+    g_paging_stats.tlb_flush   = 0;
+    g_paging_stats.kswapd_reclaim = 0;
+    g_paging_stats.direct_reclaim = 0;
+    g_paging_stats.evict_clean = 0;
+    g_paging_stats.zswap_stored = 0;
+    g_paging_stats.zswap_same_filled = 0;
+    g_paging_stats.zswap_reject = 0;
 }
 
 /* Print in a fixed format so run_paging_tests.sh can grep them. */
@@ -137,8 +167,15 @@ struct mm_struct {
    /* Currently we support a fixed number of symbol */
    struct vm_rg_struct symrgtbl[PAGING_MAX_SYMTBL_SZ];
 
-   /* list of free page (for FIFO replacement) */
-   struct pgn_t *fifo_pgn;
+   /* resident pages, ordered by the page replacement policy */
+   struct pgrepl_t *repl;
+
+   /* swap slots still holding a copy of clean resident pages */
+   struct swapcache_t *swpcache;
+
+   /* owning process and links on the list reclaim walks */
+   struct pcb_t *owner;
+   struct mm_struct *rcl_prev, *rcl_next;
 };
 
 /*
@@ -161,9 +198,18 @@ struct memphy_struct {
    int rdmflg;
    int cursor;
 
-   /* Management structure */
-   struct framephy_struct *free_fp_list;
-   struct framephy_struct *used_fp_list;
+   /* Management structure: packed frame bitmap, bit set = frame in use */
+   unsigned long *fp_bitmap;
+   int pagesz;
+   int numfp;
+   int freefp;       /* number of free frames */
+   int fp_hint;      /* bitmap word to start the next free-frame scan */
+   int clu_next;     /* next frame of the current swap cluster */
+   int clu_end;      /* end of the current swap cluster */
+   unsigned long *fp_touched; /* frames written since last cleared */
+
+   /* Host file the content lives in instead of storage, or NULL */
+   struct memphy_file *file;
 };
 
 #endif /* OSMM_H */
@@ -0,0 +1,41 @@
+#ifndef PGNHASH_H
+#define PGNHASH_H
+
+#include "common.h"
+
+/*
+ * Hash of nodes keyed by page number
+ *
+ * The table is intrusive: a user embeds struct pgn_hnode as the first
+ * member of its own node, and casts what pgn_hash_find() returns back
+ * to that node. Chains are kept short by doubling the table whenever
+ * it holds as many nodes as it has slots.
+ */
+
+struct pgn_hnode {
+	addr_t pgn;
+	struct pgn_hnode *next;		/* on its hash chain */
+};
+
+struct pgn_hash {
+	struct pgn_hnode **slot;
+	unsigned int size;		/* a power of two */
+	unsigned int count;
+};
+
+/* Return -1 if the table cannot be allocated */
+int pgn_hash_init(struct pgn_hash * h);
+
+/* Free the table, the nodes still on it belong to the caller */
+void pgn_hash_free(struct pgn_hash * h);
+
+/* Add [n], keyed by n->pgn, which must be set */
+void pgn_hash_add(struct pgn_hash * h, struct pgn_hnode * n);
+
+/* First node of page [pgn], NULL if there is none */
+struct pgn_hnode * pgn_hash_find(struct pgn_hash * h, addr_t pgn);
+
+/* Remove [n], which must be on the table */
+void pgn_hash_del(struct pgn_hash * h, struct pgn_hnode * n);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef PGREPL_H
+#define PGREPL_H
+
+#include "common.h"
+
+/*
+ * Page replacement policies
+ *
+ * Every mm keeps the pages it has resident in MEMRAM in a replacement
+ * state owned by one policy. The paging code tells the policy when a
+ * page becomes resident and asks it for a victim when RAM is full;
+ * both run in O(1) amortized time. Policies other than fifo read and
+ * clear the PTE accessed bit, which the translation path sets on
+ * every access.
+ *
+ *   fifo  - evict in load order
+ *   clock - second chance: referenced pages are skipped once
+ *   2q    - probation FIFO (A1in), ghost FIFO of pages evicted from
+ *           it (A1out) and a CLOCK of pages faulted back in from the
+ *           ghosts (Am)
+ *   arc   - adaptive replacement (the CLOCK variant, CAR), balancing a
+ *           recency and a frequency clock by hits in their ghost lists
+ *
+ * The policy is chosen once per run, before any mm is created.
+ */
+
+#ifndef PG_REPL_POLICY
+#define PG_REPL_POLICY "fifo"
+#endif
+
+struct pgrepl_t;
+
+/* Use the policy called [name] for every mm created from now on,
+ * return -1 if there is no such policy */
+int pgrepl_select(const char * name);
+
+/* Name of the policy in use */
+const char * pgrepl_name(void);
+
+/* Space separated names of every policy, for usage messages */
+const char * pgrepl_names(void);
+
+struct pgrepl_t * pgrepl_create(void);
+void pgrepl_destroy(struct pgrepl_t * repl);
+
+/* Page [pgn] was just made resident */
+int pgrepl_insert(struct pgrepl_t * repl, addr_t pgn);
+
+/* Pick a resident page of [caller]'s mm to evict and forget it.
+ * Return -1 if the mm has no resident page. */
+int pgrepl_evict(struct pgrepl_t * repl, struct pcb_t * caller,
+		 addr_t * pgn);
+
+/* Undo the pgrepl_evict() that just returned [pgn]: the page stays
+ * resident, back at the head of the list it was taken from */
+int pgrepl_reinsert(struct pgrepl_t * repl, addr_t pgn);
+
+#endif
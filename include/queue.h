@@ -4,20 +4,74 @@
 
 #include "common.h"
 
+/* Initial capacity of a queue, queues grow on demand */
 #define MAX_QUEUE_SIZE 50
 
+/*
+ * FIFO queue of PCBs kept in a growable ring buffer. A zero-filled
+ * queue_t is a valid empty queue; storage is allocated on first use.
+ */
 struct queue_t {
-	struct pcb_t * proc[MAX_QUEUE_SIZE];
+	struct pcb_t ** proc;
+	int head;	/* index of the oldest entry */
 	int size;
+	int cap;
 };
 
 void enqueue(struct queue_t * q, struct pcb_t * proc);
 
+/* Remove and return the oldest process */
 struct pcb_t * dequeue(struct queue_t * q);
 
+/* Remove and return the most recently enqueued process */
+struct pcb_t * dequeue_tail(struct queue_t * q);
+
 struct pcb_t *purgequeue(struct queue_t *q, struct pcb_t *proc);
 
 int empty(struct queue_t * q);
 
+/*
+ * Intrusive doubly-linked list of PCBs threaded through the q_prev and
+ * q_next links of struct pcb_t. A PCB sits on at most one such list at
+ * a time, recorded in q_list, so it can be unlinked in O(1) without
+ * searching. A zero-filled proc_list_t is a valid empty list.
+ */
+struct proc_list_t {
+	struct pcb_t * head;
+	struct pcb_t * tail;
+	int size;
+};
+
+void plist_add_tail(struct proc_list_t * l, struct pcb_t * proc);
+
+/* Unlink [proc] from [l]; return NULL if it is not on [l] */
+struct pcb_t * plist_remove(struct proc_list_t * l, struct pcb_t * proc);
+
+int plist_empty(struct proc_list_t * l);
+
+/*
+ * Priority queue of PCBs kept in a growable binary min-heap keyed on
+ * the process priority (lower value = higher priority). Processes of
+ * equal priority leave in FIFO order. A zero-filled prio_queue_t is a
+ * valid empty queue.
+ */
+struct prio_queue_t {
+	struct pq_node_t {
+		struct pcb_t * proc;
+		uint32_t prio;
+		unsigned long seq;
+	} * heap;
+	int size;
+	int cap;
+	unsigned long seq;	/* enqueue counter, breaks priority ties */
+};
+
+void pq_enqueue(struct prio_queue_t * q, struct pcb_t * proc);
+
+/* Remove and return the process with the highest priority */
+struct pcb_t * pq_dequeue(struct prio_queue_t * q);
+
+int pq_empty(struct prio_queue_t * q);
+
 #endif
 
@@ -11,7 +11,8 @@
 
 int queue_empty(void);
 
-void init_scheduler(void);
+/* Set up one run queue per simulated CPU */
+void init_scheduler(int num_cpus);
 void finish_scheduler(void);
 
 /* Get the next process from ready queue */
@@ -23,6 +24,9 @@ void put_proc(struct pcb_t * proc);
 /* Add a new process to ready queue */
 void add_proc(struct pcb_t * proc);
 
+/* Remove a finished process from the scheduler's running list */
+void finish_proc(struct pcb_t * proc);
+
 #endif
 
 
@@ -0,0 +1,30 @@
+#ifndef SWAP_H
+#define SWAP_H
+
+#include "common.h"
+
+/*
+ * Swap devices
+ *
+ * Every configured MEMSWP device takes swap. Slots come from the
+ * devices of the highest priority that still have room; runs of slots
+ * rotate round robin among devices of equal priority, so that pages
+ * reclaimed one after another are striped across them. A swapped PTE
+ * records the index of its device in SWPTYP.
+ *
+ * Devices have priority 0 unless a workload spec sets "swap_prio", so
+ * all devices of a config line are striped by default.
+ */
+
+/* Let swap use [dev], the MEMSWP device of index [swptyp] */
+int swap_on(struct memphy_struct * dev, int swptyp, int prio);
+
+/* Claim up to [n] consecutive slots of one device. Return how many,
+ * with the device in [swptyp] and the first slot in [slot], 0 once
+ * every device is full. */
+int swap_get_slots(int n, int * swptyp, addr_t * slot);
+
+/* Device of swap type [swptyp], NULL if it is not swapped on */
+struct memphy_struct * swap_device(int swptyp);
+
+#endif
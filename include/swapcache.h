@@ -0,0 +1,32 @@
+#ifndef SWAPCACHE_H
+#define SWAPCACHE_H
+
+#include "common.h"
+
+/*
+ * Swap cache
+ *
+ * A page swapped back in keeps its swap slot for as long as it stays
+ * clean, and the swap cache of its mm remembers which slot that is.
+ * Evicting such a page again is then only a PTE update. The first
+ * write to the page makes the copy in swap stale and releases the
+ * slot.
+ */
+
+struct swapcache_t;
+
+struct swapcache_t * swapcache_create(void);
+
+/* Release every remembered slot on [mswp] and free the cache */
+void swapcache_destroy(struct swapcache_t * sc, struct memphy_struct ** mswp);
+
+/* Remember that resident page [pgn] has a copy at [swpoff] of swap
+ * device [swptyp] */
+int swapcache_add(struct swapcache_t * sc, addr_t pgn,
+		  int swptyp, addr_t swpoff);
+
+/* Look up the slot of [pgn] and forget it. Return -1 if it has none. */
+int swapcache_take(struct swapcache_t * sc, addr_t pgn,
+		   int * swptyp, addr_t * swpoff);
+
+#endif
@@ -4,13 +4,24 @@
 #include <pthread.h>
 #include <stdint.h>
 
+/*
+ * Every attached device (CPU or loader) is a participant of a global
+ * sense-reversing tick barrier. next_slot() arrives at the barrier and
+ * waits for the slot to end; the last participant to arrive advances
+ * the clock and releases the others. A detached device no longer takes
+ * part, the clock stops once every device has detached.
+ *
+ * With TIMER_EVENT_DRIVEN (os-cfg.h) a device may tell the barrier it
+ * has nothing to do before a given time, see next_slot_until(). When
+ * every device in a slot is idle, the clock jumps straight to the
+ * earliest such time instead of ticking through the idle slots.
+ */
+
+/* Wake-up time of a device waiting on events from other devices only */
+#define TIMER_NEVER UINT64_MAX
 struct timer_id_t {
-	int done;
-	int fsh;
-	pthread_cond_t event_cond;
-	pthread_mutex_t event_lock;
-	pthread_cond_t timer_cond;
-	pthread_mutex_t timer_lock;
+	int fsh;	/* detached from the barrier */
+	int sense;	/* sense of the slot this device is waiting on */
 };
 
 void start_timer();
@@ -23,6 +34,15 @@ void detach_event(struct timer_id_t * event);
 
 void next_slot(struct timer_id_t* timer_id);
 
+/* Like next_slot(), but the device is idle until time [wake] */
+void next_slot_until(struct timer_id_t* timer_id, uint64_t wake);
+
+/* Call [hook] at the end of every slot, before any device moves on to
+ * the next one. It runs on the thread of the last device to arrive.
+ * NULL removes it. */
+void timer_set_slot_hook(void (*hook)(void));
+
 uint64_t current_time();
 
 #endif
+
@@ -0,0 +1,52 @@
+#ifndef TLB_H
+#define TLB_H
+
+#include "common.h"
+
+/*
+ * Per-CPU software TLB
+ *
+ * Each simulated CPU owns a set-associative TLB caching pgn -> PTE
+ * translations. Entries are tagged with an address-space id (the PGD
+ * base of the owning mm), so no flush is needed on context switch.
+ * Geometry is set by TLB_NUM_SETS / TLB_NUM_WAYS in os-cfg.h.
+ *
+ * Lookups and fills only touch the TLB of the calling CPU (see
+ * cpu_current()); threads that are not CPUs always miss and never
+ * fill. Invalidation is a shootdown across every CPU.
+ */
+
+#ifndef TLB_NUM_SETS
+#define TLB_NUM_SETS 16
+#endif
+
+#ifndef TLB_NUM_WAYS
+#define TLB_NUM_WAYS 4
+#endif
+
+/* Translation handed back on a hit */
+struct tlb_entry_t {
+	addr_t   asid;     /* address-space id, PGD base of the mm */
+	addr_t   pgn;      /* virtual page number */
+	addr_t   fpn;      /* physical frame number */
+	addr_t   pte_addr; /* MEMRAM address of the leaf PTE */
+	int      valid;
+};
+
+/* Allocate one TLB for each of [num_cpus] simulated CPUs */
+int tlb_init(int num_cpus);
+
+/* Look up [pgn] of address space [asid] in the calling CPU's TLB.
+ * Return 0 and fill [ent] on hit, -1 on miss. */
+int tlb_lookup(addr_t asid, addr_t pgn, struct tlb_entry_t *ent);
+
+/* Cache a present translation in the calling CPU's TLB */
+void tlb_insert(addr_t asid, addr_t pgn, addr_t pte_addr, uint32_t pte);
+
+/* Drop [pgn] of [asid] from every CPU's TLB */
+void tlb_invalidate(addr_t asid, addr_t pgn);
+
+/* Drop every entry of [asid] from every CPU's TLB */
+void tlb_flush_asid(addr_t asid);
+
+#endif
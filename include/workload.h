@@ -0,0 +1,100 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include "common.h"
+#include <stdio.h>
+
+/*
+ * Workload sources
+ *
+ * The loader pulls process arrivals one at a time from a workload
+ * source, so a run no longer needs its whole process list up front.
+ * Sources hand out arrivals in non-decreasing start time order:
+ *
+ *   trace   - "start program [prio]" lines read lazily from a file,
+ *             which is also how the process lines of a classic
+ *             config are consumed
+ *   poisson - exponential inter-arrival times at a mean rate
+ *   bursty  - Poisson bursts of several processes arriving together
+ *
+ * Every source stops after [max_ticks] simulated ticks or
+ * [max_procs] arrivals, whichever comes first (0 means no limit).
+ */
+
+#define WL_PATH_LEN	100
+#define WL_MAX_PROGS	32
+#define WL_PRIO_DEFAULT	(-1L)	/* run at the program's own priority */
+
+struct wl_arrival_t {
+	uint64_t start_time;
+	char path[WL_PATH_LEN];
+	long prio;		/* WL_PRIO_DEFAULT if the source has none */
+};
+
+struct workload_t {
+	/* Fill [arr] with the next arrival, return 0 once exhausted */
+	int (*next)(struct workload_t * wl, struct wl_arrival_t * arr);
+	void (*close)(struct workload_t * wl);
+	uint64_t max_ticks;
+	uint64_t max_procs;
+	uint64_t produced;
+	int done;
+};
+
+enum wl_kind_t {
+	WL_TRACE,
+	WL_POISSON,
+	WL_BURSTY,
+};
+
+/* Parameters of a workload spec file, see workload_read_spec() */
+struct wl_spec_t {
+	enum wl_kind_t kind;
+	int time_slot;
+	int num_cpus;
+	int num_memsz;			/* entries set in memsz */
+	unsigned long memsz[5];		/* RAM then swap devices */
+	uint64_t max_ticks;
+	uint64_t max_procs;
+	double rate;			/* mean arrivals per tick */
+	int burst;			/* processes per burst (bursty) */
+	uint64_t seed;
+	long prio_lo, prio_hi;		/* uniform, or WL_PRIO_DEFAULT */
+	int num_progs;
+	char prog[WL_MAX_PROGS][WL_PATH_LEN];
+	unsigned int weight[WL_MAX_PROGS];
+	char trace[WL_PATH_LEN];	/* trace file (trace) */
+	char replace[16];		/* page replacement policy, if set */
+	int num_swap_prio;		/* entries set in swap_prio */
+	int swap_prio[4];		/* priority of each swap device */
+};
+
+/* Return the next arrival of [wl] in [arr], 0 once it is exhausted */
+int workload_next(struct workload_t * wl, struct wl_arrival_t * arr);
+
+void workload_close(struct workload_t * wl);
+
+/* Stream "start program [prio]" lines from [file], prefixing program
+ * names with [dir]. The source owns [file] if [own] is set. */
+struct workload_t * workload_trace(FILE * file, const char * dir, int own);
+
+/* Parse a workload spec from [file]. Its first line, "workload <kind>",
+ * has already been consumed by the caller. Return 0 on success. */
+int workload_read_spec(FILE * file, const char * path,
+		       enum wl_kind_t kind, struct wl_spec_t * spec);
+
+/* Open the source described by [spec] */
+struct workload_t * workload_open(const struct wl_spec_t * spec);
+
+/*
+ * Completion metrics
+ */
+
+/* Record a finished process: it arrived at [arrival], first ran at
+ * [first_run] and finished at [now] */
+void wl_stats_finish(uint64_t arrival, uint64_t first_run, uint64_t now);
+
+/* Print throughput and turnaround/response percentiles of the run */
+void wl_stats_print(uint64_t ticks, double wall_sec);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef ZSWAP_H
+#define ZSWAP_H
+
+#include "common.h"
+
+/*
+ * Compressed swap pool
+ *
+ * A dirty page being paged out is first compressed into a pool of
+ * ZSWAP_POOL_SIZE bytes (os-cfg.h) kept outside the simulated devices.
+ * A page repeating one 32-bit word, zero pages most of all, takes no
+ * pool space. Only pages that compress poorly or no longer fit go on to
+ * the active MEMSWP device.
+ *
+ * A pooled page is swapped out with swap type ZSWAP_SWPTYP and its pool
+ * handle as offset. Loading it back frees the pool copy, the page is
+ * then dirty and compressed again when evicted.
+ */
+
+#ifndef ZSWAP_POOL_SIZE
+#define ZSWAP_POOL_SIZE (1 << 20)
+#endif
+
+/* Highest swap type, never one of the MEMSWP devices */
+#define ZSWAP_SWPTYP	31
+
+/* Set up a pool of [size] bytes for pages of [pagesz] bytes */
+int zswap_init(size_t size, addr_t pagesz);
+
+/* Compress frame [fpn] of [mram] into the pool. Return -1 if it does
+ * not compress well or the pool is full. */
+int zswap_store(struct memphy_struct * mram, addr_t fpn, addr_t * handle);
+
+/* Decompress pool entry [handle] into frame [fpn] of [mram] */
+int zswap_load(addr_t handle, struct memphy_struct * mram, addr_t fpn);
+
+/* Drop pool entry [handle] */
+void zswap_free(addr_t handle);
+
+#endif
@@ -18,8 +18,12 @@ PAGING_CFGS=(
   os_1_singleCPU_mlq_paging
   os_demand_small_5level
   os_swap_fifo
+  os_repl_reuse
 )
 
+# ---- Replacement policies compared on os_repl_reuse ----
+REPL_POLICIES=(fifo clock 2q arc)
+
 # ---- Expected STATS tags the OS must print ----
 STATS_TAGS=(
   mem_access      # total page-table lookups
@@ -27,6 +31,9 @@ STATS_TAGS=(
   swap_in         # number of swap-ins
   swap_out        # number of swap-outs
   pt_bytes        # bytes used for page tables
+  tlb_hit         # translations served by the per-CPU TLB
+  tlb_miss        # translations that needed a full page walk
+  tlb_flush       # TLB entries dropped by invalidation
 )
 
 # ---- Colors ----
@@ -300,11 +307,209 @@ logic_check_singlecpu_mlq() {
   fi
 }
 
+# ---- 2.4 TLB effectiveness: report hit rate of every config ----
+report_tlb_hit_rates() {
+  echo "[TLB] Per-CPU TLB hit rates ..."
+
+  local cfg file tlb_hit tlb_miss tlb_flush total rate
+  for cfg in "${PAGING_CFGS[@]}"; do
+    file="${ACTUAL_DIR}/${cfg}.actual"
+    if [[ ! -f "${file}" ]]; then
+      continue
+    fi
+
+    tlb_hit=$(parse_stat "${file}" "tlb_hit")
+    tlb_miss=$(parse_stat "${file}" "tlb_miss")
+    tlb_flush=$(parse_stat "${file}" "tlb_flush")
+
+    if (( tlb_hit < 0 || tlb_miss < 0 )); then
+      echo -e "  ${YELLOW}[SKIP]${NC} ${cfg}: no TLB stats"
+      continue
+    fi
+
+    total=$(( tlb_hit + tlb_miss ))
+    if (( total > 0 )); then
+      rate=$(awk -v h="${tlb_hit}" -v t="${total}" 'BEGIN { printf "%.1f%%", 100.0 * h / t }')
+    else
+      rate="n/a"
+    fi
+
+    printf "  %-28s hit=%-8s miss=%-8s flush=%-8s rate=%s\n" \
+      "${cfg}" "${tlb_hit}" "${tlb_miss}" "${tlb_flush}" "${rate}"
+  done
+}
+
+# ---- 2.5 Replacement policies: os_repl_reuse under each policy ----
+#   A hot set of 4 pages is reused between chunks of a 16-page scan in
+#   too little RAM. Every run pages out to MEMSWP (-z 0, no zswap), so
+#   the fault counts of the policies can be compared.
+run_repl_cfg() {
+  local tag="$1"
+  shift
+  local file="${ACTUAL_DIR}/os_repl_reuse.${tag}.actual"
+
+  set +e
+  "${OS_BIN}" "$@" os_repl_reuse >"${file}" 2>&1
+  local rc=$?
+  set -e
+
+  if [[ $rc -ne 0 ]]; then
+    echo -e "  ${RED}[LOGIC FAIL]${NC} 'os $* os_repl_reuse' exited with status ${rc}, see ${file}."
+    logic_fail=true
+    return 1
+  fi
+  return 0
+}
+
+logic_check_repl_policies() {
+  if [[ ! -f "${INPUT_DIR}/os_repl_reuse" ]]; then
+    echo -e "  ${YELLOW}[SKIP]${NC} os_repl_reuse not found"
+    return
+  fi
+
+  echo "[LOGIC] Comparing replacement policies on os_repl_reuse ..."
+
+  local policy file page_faults swap_in swap_out swap_writes kswapd_reclaim
+  local fifo_faults=-1
+  for policy in "${REPL_POLICIES[@]}"; do
+    run_repl_cfg "${policy}" -p "${policy}" -z 0 || continue
+    file="${ACTUAL_DIR}/os_repl_reuse.${policy}.actual"
+
+    page_faults=$(parse_stat "${file}" "page_faults")
+    swap_in=$(parse_stat "${file}" "swap_in")
+    swap_out=$(parse_stat "${file}" "swap_out")
+    swap_writes=$(parse_stat "${file}" "swap_writes")
+    kswapd_reclaim=$(parse_stat "${file}" "kswapd_reclaim")
+
+    printf "  %-6s page_faults=%-5s swap_in=%-5s swap_out=%-5s swap_writes=%-5s kswapd_reclaim=%s\n" \
+      "${policy}" "${page_faults}" "${swap_in}" "${swap_out}" "${swap_writes}" "${kswapd_reclaim}"
+
+    if (( swap_in > 0 && swap_out > 0 )); then
+      echo -e "  ${GREEN}[LOGIC OK]${NC} ${policy}: pages go out to SWAP and come back."
+    else
+      echo -e "  ${RED}[LOGIC FAIL]${NC} ${policy}: swap_in and swap_out should be >0 on os_repl_reuse."
+      logic_fail=true
+    fi
+
+    # kswapd pages out in batches, each written to a swap cluster at once
+    if (( swap_writes > 0 && swap_writes < swap_out )); then
+      echo -e "  ${GREEN}[LOGIC OK]${NC} ${policy}: swap_writes < swap_out (clustered page-out)."
+    else
+      echo -e "  ${RED}[LOGIC FAIL]${NC} ${policy}: expected 0 < swap_writes < swap_out, got ${swap_writes}/${swap_out}."
+      logic_fail=true
+    fi
+
+    if (( kswapd_reclaim > 0 )); then
+      echo -e "  ${GREEN}[LOGIC OK]${NC} ${policy}: kswapd reclaimed ahead of the faults."
+    else
+      echo -e "  ${RED}[LOGIC FAIL]${NC} ${policy}: kswapd_reclaim should be >0 on os_repl_reuse."
+      logic_fail=true
+    fi
+
+    if [[ "${policy}" == "fifo" ]]; then
+      fifo_faults=${page_faults}
+    elif (( fifo_faults < 0 )); then
+      :
+    elif [[ "${policy}" == "clock" ]]; then
+      if (( page_faults <= fifo_faults )); then
+        echo -e "  ${GREEN}[LOGIC OK]${NC} clock faults (${page_faults}) <= fifo faults (${fifo_faults})."
+      else
+        echo -e "  ${RED}[LOGIC FAIL]${NC} clock faults (${page_faults}) should not exceed fifo (${fifo_faults})."
+        logic_fail=true
+      fi
+    else
+      # 2q and arc keep the hot set resident through the scan
+      if (( page_faults < fifo_faults )); then
+        echo -e "  ${GREEN}[LOGIC OK]${NC} ${policy} faults (${page_faults}) < fifo faults (${fifo_faults})."
+      else
+        echo -e "  ${RED}[LOGIC FAIL]${NC} ${policy} faults (${page_faults}) should be below fifo (${fifo_faults})."
+        logic_fail=true
+      fi
+    fi
+  done
+
+  # Same policy twice: reclaim runs on simulated time, stats must match
+  if run_repl_cfg "fifo.again" -p fifo -z 0; then
+    if diff <(grep '^\[STATS\]' "${ACTUAL_DIR}/os_repl_reuse.fifo.actual" | grep -v swap_io_usec) \
+            <(grep '^\[STATS\]' "${ACTUAL_DIR}/os_repl_reuse.fifo.again.actual" | grep -v swap_io_usec) >/dev/null; then
+      echo -e "  ${GREEN}[LOGIC OK]${NC} Repeated fifo run prints the same STATS."
+    else
+      echo -e "  ${RED}[LOGIC FAIL]${NC} Repeated fifo run prints different STATS."
+      logic_fail=true
+    fi
+  fi
+}
+
+# ---- 2.6 Swap backends: zswap, sequential and file MEMSWP ----
+logic_check_swap_backends() {
+  local fifo_file="${ACTUAL_DIR}/os_repl_reuse.fifo.actual"
+  if [[ ! -f "${fifo_file}" ]]; then
+    echo -e "  ${YELLOW}[SKIP]${NC} os_repl_reuse.fifo.actual not found"
+    return
+  fi
+
+  echo "[LOGIC] Checking swap backends on os_repl_reuse ..."
+
+  local fifo_faults file val
+  fifo_faults=$(parse_stat "${fifo_file}" "page_faults")
+
+  # Default build pages out to the compressed pool first
+  file="${ACTUAL_DIR}/os_repl_reuse.actual"
+  if [[ -f "${file}" ]]; then
+    val=$(parse_stat "${file}" "zswap_stored")
+    if (( val > 0 )); then
+      echo -e "  ${GREEN}[LOGIC OK]${NC} zswap_stored > 0 with the default pool."
+    else
+      echo -e "  ${RED}[LOGIC FAIL]${NC} zswap_stored should be >0 on os_repl_reuse."
+      logic_fail=true
+    fi
+  fi
+
+  if run_repl_cfg "seq" -p fifo -z 0 -s seq; then
+    file="${ACTUAL_DIR}/os_repl_reuse.seq.actual"
+    val=$(parse_stat "${file}" "seek_bytes")
+    if (( val > 0 )); then
+      echo -e "  ${GREEN}[LOGIC OK]${NC} Sequential MEMSWP reports seeks (seek_bytes=${val})."
+    else
+      echo -e "  ${RED}[LOGIC FAIL]${NC} seek_bytes should be >0 with a sequential MEMSWP."
+      logic_fail=true
+    fi
+    val=$(parse_stat "${file}" "page_faults")
+    if (( val == fifo_faults )); then
+      echo -e "  ${GREEN}[LOGIC OK]${NC} Sequential MEMSWP faults as often as in-memory MEMSWP."
+    else
+      echo -e "  ${RED}[LOGIC FAIL]${NC} Sequential MEMSWP page_faults ${val}, expected ${fifo_faults}."
+      logic_fail=true
+    fi
+  fi
+
+  if run_repl_cfg "file" -p fifo -z 0 -s file; then
+    file="${ACTUAL_DIR}/os_repl_reuse.file.actual"
+    val=$(parse_stat "${file}" "swap_io_bytes")
+    if (( val > 0 )); then
+      echo -e "  ${GREEN}[LOGIC OK]${NC} File MEMSWP moves pages through the host file (swap_io_bytes=${val})."
+    else
+      echo -e "  ${RED}[LOGIC FAIL]${NC} swap_io_bytes should be >0 with a file MEMSWP."
+      logic_fail=true
+    fi
+    val=$(parse_stat "${file}" "page_faults")
+    if (( val == fifo_faults )); then
+      echo -e "  ${GREEN}[LOGIC OK]${NC} File MEMSWP faults as often as in-memory MEMSWP."
+    else
+      echo -e "  ${RED}[LOGIC FAIL]${NC} File MEMSWP page_faults ${val}, expected ${fifo_faults}."
+      logic_fail=true
+    fi
+  fi
+}
+
 # ---- Run logic checks ----
 logic_check_demand_small
 logic_check_small_ram "os_1_mlq_paging_small_1K"
 logic_check_small_ram "os_1_mlq_paging_small_4K"
 logic_check_singlecpu_mlq
+logic_check_repl_policies
+logic_check_swap_backends
+report_tlb_hit_rates
 
 echo "============================================================"
 
@@ -4,6 +4,21 @@
 #include "mm.h"
 #include "syscall.h"
 #include "libmem.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Simulated CPU the calling host thread is running as */
+static __thread int current_cpu = -1;
+
+void cpu_set_current(int id)
+{
+	current_cpu = id;
+}
+
+int cpu_current(void)
+{
+	return current_cpu;
+}
 
 int calc(struct pcb_t *proc)
 {
@@ -58,55 +73,126 @@ int write(
 	return write_mem(proc->regs[destination] + offset, proc, data);
 }
 
+/*
+ * Threaded interpreter
+ *
+ * cpu_decode() resolves every opcode once into the address of its
+ * handler in run(), so an instruction costs a single indirect jump
+ * instead of a struct copy plus a switch. The decoded stream carries
+ * one extra END entry, which makes running off the end of the code the
+ * same jump as any other instruction. Unknown opcodes are skipped, as
+ * run() always did.
+ */
+static const void *const *cpu_dispatch;
+
 int run(struct pcb_t *proc)
 {
-	/* Check if Program Counter point to the proper instruction */
-	if (proc->pc >= proc->code->size)
+	static const void *const dispatch[] = {
+		[CALC]    = &&do_calc,
+		[ALLOC]   = &&do_alloc,
+		[FREE]    = &&do_free,
+		[READ]    = &&do_read,
+		[WRITE]   = &&do_write,
+		[SYSCALL] = &&do_syscall,
+		[SYSCALL + 1] = &&do_end,	/* END */
+		[SYSCALL + 2] = &&do_unknown,
+	};
+	const struct dinst_t *ins;
+
+	/* cpu_decode() asks for the label table with a NULL process */
+	if (proc == NULL)
 	{
-		return 1;
+		__atomic_store_n(&cpu_dispatch, dispatch, __ATOMIC_RELAXED);
+		return 0;
 	}
 
-	struct inst_t ins = proc->code->text[proc->pc];
+	ins = &proc->code->dtext[proc->pc];
+	goto *ins->handler;
+
+do_calc:
+	proc->pc++;
+	return calc(proc);
+
+do_alloc:
 	proc->pc++;
-	int stat = 1;
-switch (ins.opcode)
-	{
-	case CALC:
-		stat = calc(proc);
-		break;
-	case ALLOC:
 #ifdef MM_PAGING
-		stat = liballoc(proc, ins.arg_0, ins.arg_1);
+	return liballoc(proc, ins->arg_0, ins->arg_1);
 #else
-		stat = alloc(proc, ins.arg_0, ins.arg_1);
+	return alloc(proc, ins->arg_0, ins->arg_1);
 #endif
-		break;
-	case FREE:
+
+do_free:
+	proc->pc++;
 #ifdef MM_PAGING
-		stat = libfree(proc, ins.arg_0);
+	return libfree(proc, ins->arg_0);
 #else
-		stat = free_data(proc, ins.arg_0);
+	return free_data(proc, ins->arg_0);
 #endif
-		break;
-	case READ:
+
+do_read:
+	proc->pc++;
 #ifdef MM_PAGING
-		stat = libread(proc, ins.arg_0, ins.arg_1, (uint32_t*) &ins.arg_2);
+	{
+		uint32_t data;
+		int rc = libread(proc, ins->arg_0, ins->arg_1, &data);
+
+		/* the value lands in the destination register */
+		if (rc == 0 && ins->arg_2 < NUM_REGS)
+			proc->regs[ins->arg_2] = data;
+		return rc;
+	}
 #else
-		stat = read(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+	return read(proc, ins->arg_0, ins->arg_1, ins->arg_2);
 #endif
-		break;
-	case WRITE:
+
+do_write:
+	proc->pc++;
 #ifdef MM_PAGING
-		stat = libwrite(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+	return libwrite(proc, ins->arg_0, ins->arg_1, ins->arg_2);
 #else
-		stat = write(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+	return write(proc, ins->arg_0, ins->arg_1, ins->arg_2);
 #endif
-		break;
-	case SYSCALL:
-		stat = libsyscall(proc, ins.arg_0, ins.arg_1, ins.arg_2, ins.arg_3);
-		break;
-	default:
-		stat = 1;
+
+do_syscall:
+	proc->pc++;
+	return libsyscall(proc, ins->arg_0, ins->arg_1, ins->arg_2, ins->arg_3);
+
+do_unknown:
+	proc->pc++;
+	return 1;
+
+do_end:
+	return 1;
+}
+
+int cpu_decode(struct code_seg_t *code)
+{
+	const void *const *dispatch;
+	uint32_t i;
+
+	run(NULL);
+	dispatch = __atomic_load_n(&cpu_dispatch, __ATOMIC_RELAXED);
+
+	code->dtext = malloc(sizeof(struct dinst_t) * (code->size + 1));
+	if (code->dtext == NULL)
+		return -1;
+
+	for (i = 0; i < code->size; i++)
+	{
+		const struct inst_t *in = &code->text[i];
+		struct dinst_t *out = &code->dtext[i];
+
+		if ((unsigned)in->opcode > SYSCALL)
+			out->handler = dispatch[SYSCALL + 2];
+		else
+			out->handler = dispatch[in->opcode];
+		out->arg_0 = in->arg_0;
+		out->arg_1 = in->arg_1;
+		out->arg_2 = in->arg_2;
+		out->arg_3 = in->arg_3;
 	}
-	return stat;
+
+	memset(&code->dtext[code->size], 0, sizeof(struct dinst_t));
+	code->dtext[code->size].handler = dispatch[SYSCALL + 1];
+	return 0;
 }
@@ -0,0 +1,309 @@
+
+#include "image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define OPT_CALC	"calc"
+#define OPT_ALLOC	"alloc"
+#define OPT_FREE	"free"
+#define OPT_READ	"read"
+#define OPT_WRITE	"write"
+#define OPT_SYSCALL	"syscall"
+
+/* Text offset of a freshly written image, keeps 64-bit args aligned */
+#define PIMG_TEXT_OFF	((sizeof(struct pimg_header_t) + 7) & ~(size_t)7)
+
+/* Return the opcode named [opt], -1 if there is none */
+static int get_opcode(const char * opt) {
+	if (!strcmp(opt, OPT_CALC)) {
+		return CALC;
+	}else if (!strcmp(opt, OPT_ALLOC)) {
+		return ALLOC;
+	}else if (!strcmp(opt, OPT_FREE)) {
+		return FREE;
+	}else if (!strcmp(opt, OPT_READ)) {
+		return READ;
+	}else if (!strcmp(opt, OPT_WRITE)) {
+		return WRITE;
+	}else if (!strcmp(opt, OPT_SYSCALL)) {
+		return SYSCALL;
+	}else{
+		return -1;
+	}
+}
+
+/* Arguments an opcode cannot do without */
+static int min_args(int opcode) {
+	switch (opcode) {
+	case ALLOC:
+		return 2;
+	case FREE:
+	case SYSCALL:
+		return 1;
+	case READ:
+	case WRITE:
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+int image_parse_text(FILE *file, const char *path,
+		     uint32_t *priority, struct code_seg_t *code)
+{
+	char line[256];
+	int lineno = 0;
+	int have_header = 0;
+	uint32_t n = 0;
+
+	memset(code, 0, sizeof(struct code_seg_t));
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		unsigned long long arg[4] = { 0, 0, 0, 0 };
+		char opt[16];
+		char *comment = strchr(line, '#');
+		int opcode, nargs;
+
+		lineno++;
+		if (comment != NULL)
+			*comment = '\0';
+		if (sscanf(line, "%15s", opt) != 1)
+			continue;	/* blank or comment-only line */
+
+		if (!have_header) {
+			if (sscanf(line, "%u %u", priority, &code->size) != 2) {
+				printf("%s:%d: expected \"priority size\" header\n",
+				       path, lineno);
+				goto fail;
+			}
+			code->text = calloc(code->size ? code->size : 1,
+					    sizeof(struct inst_t));
+			if (code->text == NULL)
+				goto fail;
+			have_header = 1;
+			continue;
+		}
+
+		opcode = get_opcode(opt);
+		if (opcode < 0) {
+			printf("%s:%d: unknown opcode '%s'\n", path, lineno, opt);
+			goto fail;
+		}
+		if (n == code->size) {
+			printf("%s:%d: more than the %u declared instructions\n",
+			       path, lineno, code->size);
+			goto fail;
+		}
+
+		nargs = sscanf(line, "%*s %llu %llu %llu %llu",
+			       &arg[0], &arg[1], &arg[2], &arg[3]);
+		if (nargs < 0)
+			nargs = 0;	/* nothing after the opcode */
+		if (nargs < min_args(opcode)) {
+			printf("%s:%d: '%s' needs %d arguments\n",
+			       path, lineno, opt, min_args(opcode));
+			goto fail;
+		}
+
+		code->text[n].opcode = opcode;
+		code->text[n].arg_0 = arg[0];
+		code->text[n].arg_1 = arg[1];
+		code->text[n].arg_2 = arg[2];
+		code->text[n].arg_3 = arg[3];
+		n++;
+	}
+
+	if (!have_header) {
+		printf("%s: empty process description\n", path);
+		goto fail;
+	}
+	if (n < code->size) {
+		/* run what is there rather than uninitialised instructions */
+		printf("%s: %u instructions declared, %u found\n",
+		       path, code->size, n);
+		code->size = n;
+	}
+	return 0;
+
+fail:
+	free(code->text);
+	code->text = NULL;
+	code->size = 0;
+	return -1;
+}
+
+int image_write(FILE *file, uint32_t priority,
+		const struct code_seg_t *code)
+{
+	static const char pad[8];
+	struct pimg_header_t hdr;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic     = PIMG_MAGIC;
+	hdr.version   = PIMG_VERSION;
+	hdr.inst_size = sizeof(struct inst_t);
+	hdr.arg_size  = sizeof(arg_t);
+	hdr.priority  = priority;
+	hdr.size      = code->size;
+	hdr.text_off  = PIMG_TEXT_OFF;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, file) != 1)
+		return -1;
+	if (fwrite(pad, 1, PIMG_TEXT_OFF - sizeof(hdr), file)
+	    != PIMG_TEXT_OFF - sizeof(hdr))
+		return -1;
+	if (code->size > 0 &&
+	    fwrite(code->text, sizeof(struct inst_t), code->size, file)
+	    != code->size)
+		return -1;
+	return 0;
+}
+
+/* Reject records whose opcode the text parser would not have produced */
+static int image_check(const char *path, const struct code_seg_t *code)
+{
+	uint32_t i;
+
+	for (i = 0; i < code->size; i++) {
+		if ((unsigned)code->text[i].opcode > SYSCALL) {
+			printf("%s: instruction %u: unknown opcode %u\n",
+			       path, i, (unsigned)code->text[i].opcode);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Widen the records of an image written with another inst_t layout */
+static int image_convert(const struct pimg_header_t *hdr,
+			 const unsigned char *text, struct code_seg_t *code)
+{
+	uint32_t i;
+	int a;
+
+	if (hdr->arg_size != 4 && hdr->arg_size != 8)
+		return -1;
+	if (hdr->inst_size < 4 + 4 * hdr->arg_size)
+		return -1;
+
+	code->text = calloc(hdr->size ? hdr->size : 1, sizeof(struct inst_t));
+	if (code->text == NULL)
+		return -1;
+
+	for (i = 0; i < hdr->size; i++) {
+		const unsigned char *rec = text + (size_t)i * hdr->inst_size;
+		/* args are the trailing fields of a record */
+		const unsigned char *args = rec + hdr->inst_size - 4 * hdr->arg_size;
+		arg_t *dst = &code->text[i].arg_0;
+		uint32_t opcode;
+
+		memcpy(&opcode, rec, sizeof(opcode));
+		code->text[i].opcode = opcode;
+		for (a = 0; a < 4; a++) {
+			uint64_t v64 = 0;
+			uint32_t v32 = 0;
+
+			if (hdr->arg_size == 8) {
+				memcpy(&v64, args + 8 * a, 8);
+			} else {
+				memcpy(&v32, args + 4 * a, 4);
+				v64 = v32;
+			}
+			dst[a] = (arg_t)v64;
+		}
+	}
+	return 0;
+}
+
+int image_map(const char *path, uint32_t *priority,
+	      struct code_seg_t *code)
+{
+	struct pimg_header_t hdr;
+	struct stat st;
+	unsigned char *base;
+	int fd;
+
+	memset(code, 0, sizeof(struct code_seg_t));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 1;
+	if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+	    hdr.magic != PIMG_MAGIC) {
+		close(fd);
+		return 1;
+	}
+
+	if (hdr.version != PIMG_VERSION) {
+		printf("%s: image version %u, expected %u\n",
+		       path, hdr.version, PIMG_VERSION);
+		goto fail_fd;
+	}
+	if (fstat(fd, &st) != 0 || hdr.inst_size == 0 ||
+	    hdr.text_off < sizeof(hdr) ||
+	    (uint64_t)st.st_size < (uint64_t)hdr.text_off +
+				   (uint64_t)hdr.size * hdr.inst_size) {
+		printf("%s: truncated or damaged image\n", path);
+		goto fail_fd;
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		perror("mmap process image");
+		return -1;
+	}
+
+	*priority  = hdr.priority;
+	code->size = hdr.size;
+
+	if (hdr.inst_size == sizeof(struct inst_t) &&
+	    hdr.arg_size == sizeof(arg_t) &&
+	    hdr.text_off % sizeof(arg_t) == 0) {
+		/* same layout as ours: execute straight from the mapping */
+		code->text     = (struct inst_t *)(base + hdr.text_off);
+		code->map_base = base;
+		code->map_len  = st.st_size;
+		if (image_check(path, code) != 0) {
+			image_unmap(code);
+			code->size = 0;
+			return -1;
+		}
+		return 0;
+	}
+
+	if (image_convert(&hdr, base + hdr.text_off, code) != 0) {
+		printf("%s: unsupported instruction layout (%u/%u bytes)\n",
+		       path, hdr.inst_size, hdr.arg_size);
+		munmap(base, st.st_size);
+		code->size = 0;
+		return -1;
+	}
+	munmap(base, st.st_size);
+	if (image_check(path, code) != 0) {
+		image_unmap(code);
+		code->size = 0;
+		return -1;
+	}
+	return 0;
+
+fail_fd:
+	close(fd);
+	return -1;
+}
+
+void image_unmap(struct code_seg_t *code)
+{
+	if (code->map_base != NULL)
+		munmap(code->map_base, code->map_len);
+	else
+		free(code->text);
+	code->text = NULL;
+	code->map_base = NULL;
+	code->map_len = 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * Background page-out daemon
+ * mm/kswapd.c
+ */
+
+#include "kswapd.h"
+#include "mm.h"
+#include "libmem.h"
+#include "timer.h"
+#include <stdio.h>
+
+static struct {
+	struct memphy_struct *mram;
+	int low, high;			/* watermarks, in free frames */
+	int wanted;			/* a wakeup is pending */
+} kd;
+
+static inline int free_frames(struct memphy_struct *mram)
+{
+	return __atomic_load_n(&mram->freefp, __ATOMIC_RELAXED);
+}
+
+/* Runs between two slots, while every device waits on the barrier */
+static void kswapd_slot_end(void)
+{
+	if (!__atomic_exchange_n(&kd.wanted, 0, __ATOMIC_ACQ_REL))
+		return;
+
+	/* Nothing reclaimable is left when a batch comes back empty, wait
+	 * for the next wakeup then */
+	while (free_frames(kd.mram) < kd.high &&
+	       pg_reclaim(kd.mram, KSWAPD_BATCH) > 0)
+		;
+}
+
+int kswapd_start(struct memphy_struct *mram)
+{
+	kd.mram = mram;
+	kd.low = mram->numfp * KSWAPD_LOW_PCT / 100;
+	if (kd.low < 1)
+		kd.low = 1;
+	kd.high = mram->numfp * KSWAPD_HIGH_PCT / 100;
+	if (kd.high <= kd.low)
+		kd.high = kd.low + 1;
+	kd.wanted = 0;
+
+	timer_set_slot_hook(kswapd_slot_end);
+	printf("[BOOT] kswapd watermarks: low=%d high=%d of %d frames\n",
+	       kd.low, kd.high, mram->numfp);
+	return 0;
+}
+
+void kswapd_stop(void)
+{
+	timer_set_slot_hook(NULL);
+}
+
+void kswapd_wakeup(struct memphy_struct *mram)
+{
+	if (mram != kd.mram || free_frames(mram) >= kd.low)
+		return;
+
+	__atomic_store_n(&kd.wanted, 1, __ATOMIC_RELEASE);
+}
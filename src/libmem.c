@@ -19,12 +19,46 @@
 #include "mm64.h"
 #include "syscall.h"
 #include "libmem.h"
+#include "pgrepl.h"
+#include "kswapd.h"
+#include "swapcache.h"
+#include "zswap.h"
+#include "swap.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <pthread.h>
 
 static pthread_mutex_t mmvm_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/* Address spaces of live processes, a circular list reclaim walks
+ * round robin from [reclaim_mm] */
+static struct mm_struct *reclaim_mm = NULL;
+
+#ifdef MM64
+#define PG_PAGESZ       PAGING64_PAGESZ
+#define PG_PGN(addr)    PAGING64_PGN(addr)
+#define PG_OFFST(addr)  PAGING64_OFFST(addr)
+#define PG_LEVELS       PAGING64_LEVELS
+#else
+#define PG_PAGESZ       PAGING_PAGESZ
+#define PG_PGN(addr)    PAGING_PGN(addr)
+#define PG_OFFST(addr)  PAGING_OFFST(addr)
+#define PG_LEVELS       1
+#endif
+
+/* An access at [offset] of region [rg] stays inside it and its vma */
+static int rg_valid_access(struct vm_rg_struct *rg, struct vm_area_struct *vma,
+                           addr_t offset)
+{
+  if (rg == NULL || vma == NULL)
+    return 0;
+  if (rg->rg_start == rg->rg_end)
+    return 0; /* not allocated */
+  if (offset >= rg->rg_end - rg->rg_start)
+    return 0;
+  return rg->rg_start + offset < vma->sbrk;
+}
+
 /*enlist_vm_freerg_list - add new rg to freerg_list
  *@mm: memory region
  *@rg_elmt: new region
@@ -53,7 +87,7 @@ int enlist_vm_freerg_list(struct mm_struct *mm, struct vm_rg_struct *rg_elmt)
  */
 struct vm_rg_struct *get_symrg_byid(struct mm_struct *mm, int rgid)
 {
-  if (rgid < 0 || rgid > PAGING_MAX_SYMTBL_SZ)
+  if (rgid < 0 || rgid >= PAGING_MAX_SYMTBL_SZ)
     return NULL;
 
   return &mm->symrgtbl[rgid];
@@ -135,7 +169,7 @@ int __free(struct pcb_t *caller, int vmaid, int rgid)
 {
   pthread_mutex_lock(&mmvm_lock);
 
-  if (rgid < 0 || rgid > PAGING_MAX_SYMTBL_SZ)
+  if (rgid < 0 || rgid >= PAGING_MAX_SYMTBL_SZ)
   {
     pthread_mutex_unlock(&mmvm_lock);
     return -1;
@@ -212,6 +246,211 @@ printf("%s:%d\n",__func__,__LINE__);
   return 0;//val;
 }
 
+/* Dirty pages reclaim is paging out, written to consecutive slots of
+ * one swap cluster in a single transfer. Each run of slots may be on a
+ * different device. */
+struct pg_wbatch {
+  struct pcb_t *caller;            /* first page's owner, does the write */
+  struct memphy_struct *mram;
+  struct memphy_struct *swp;
+  int swptyp;
+  addr_t slot;                     /* first claimed slot */
+  int nslots;                      /* slots claimed */
+  int n;                           /* slots used */
+  int want;                        /* pages still to reclaim */
+  addr_t fpn[SWAP_CLUSTER];        /* frames waiting to be written */
+};
+
+/*pg_wbatch_flush - write the queued pages and free their frames
+ *@wb: write batch
+ *
+ * Slots claimed but left unused go back to the device.
+ */
+static void pg_wbatch_flush(struct pg_wbatch *wb)
+{
+  int i;
+
+  if (wb->n > 0)
+    __mm_swap_pages(wb->caller, wb->fpn, wb->n, wb->swptyp, wb->slot);
+  for (i = 0; i < wb->n; i++)
+    MEMPHY_put_freefp(wb->mram, wb->fpn[i]);
+  for (i = wb->n; i < wb->nslots; i++)
+    MEMPHY_put_freefp(wb->swp, wb->slot + i);
+  wb->n = wb->nslots = 0;
+  wb->caller = NULL;
+}
+
+/*pg_wbatch_slot - get the next slot of the batch
+ *@wb: write batch
+ *@caller: owner of the page going out
+ *@retslot: return slot
+ *
+ * A new run of slots is claimed once the current one is used up.
+ */
+static int pg_wbatch_slot(struct pg_wbatch *wb, struct pcb_t *caller,
+                          addr_t *retslot)
+{
+  if (wb->n == wb->nslots)
+  {
+    pg_wbatch_flush(wb);
+    wb->nslots = swap_get_slots(wb->want, &wb->swptyp, &wb->slot);
+    if (wb->nslots == 0)
+      return -1;
+    wb->swp = swap_device(wb->swptyp);
+  }
+  if (wb->caller == NULL)
+    wb->caller = caller;
+  *retslot = wb->slot + wb->n;
+  return 0;
+}
+
+/*pg_swapout - page a victim of the caller out to swap
+ *@caller: caller
+ *@wb: write batch to queue a dirty victim on, NULL to write it now
+ *@retfpn: return the FPN it occupied
+ *
+ * Only dirty victims are copied out. A clean one still has its copy
+ * in swap (or was never written and reads as zeroes again), so the
+ * PTE just drops the frame. Returns 1 if the victim was queued on
+ * [wb], its frame is then freed by pg_wbatch_flush.
+ */
+static int pg_swapout(struct pcb_t *caller, struct pg_wbatch *wb,
+                      addr_t *retfpn)
+{
+  struct krnl_t *krnl = caller->krnl;
+  struct mm_struct *mm = krnl->mm;
+  addr_t vicpgn, vicfpn, swpfpn;
+  uint32_t vicpte;
+  int swptyp;
+  struct sc_regs regs;
+
+  /* Find victim page */
+  if (find_victim_page(caller, &vicpgn) == -1)
+    return -1;
+
+  vicpte = pte_get_entry(caller, vicpgn);
+  vicfpn = PAGING_FPN(vicpte);
+
+  if (swapcache_take(mm->swpcache, vicpgn, &swptyp, &swpfpn) != 0)
+    swptyp = -1;
+
+  if (!(vicpte & PAGING_PTE_DIRTY_MASK))
+  {
+    if (swptyp < 0)
+      pte_set_entry(caller, vicpgn, 0); /* zero page, refilled on fault */
+    else
+      pte_set_swap(caller, vicpgn, swptyp, swpfpn);
+    g_paging_stats.evict_clean++;
+    *retfpn = vicfpn;
+    return 0;
+  }
+
+  if (swptyp >= 0)
+    MEMPHY_put_freefp(krnl->mswp[swptyp], swpfpn);
+
+  /* Compress it into the pool, MEMSWP only gets what does not fit */
+  if (zswap_store(krnl->mram, vicfpn, &swpfpn) == 0)
+  {
+    pte_set_swap(caller, vicpgn, ZSWAP_SWPTYP, swpfpn);
+    g_paging_stats.swap_out++;
+    *retfpn = vicfpn;
+    return 0;
+  }
+
+  if (wb != NULL)
+  {
+    if (pg_wbatch_slot(wb, caller, &swpfpn) != 0)
+    {
+      pgrepl_reinsert(mm->repl, vicpgn); /* stays resident */
+      return -1;
+    }
+    wb->fpn[wb->n++] = vicfpn;
+    pte_set_swap(caller, vicpgn, wb->swptyp, swpfpn);
+    *retfpn = vicfpn;
+    return 1;
+  }
+
+  /* Get free frame in MEMSWP */
+  if (swap_get_slots(1, &swptyp, &swpfpn) == 0)
+  {
+    pgrepl_reinsert(mm->repl, vicpgn); /* stays resident */
+    return -1;
+  }
+
+  /* Copy victim frame to swap
+   * SWP(vicfpn <--> swpfpn)
+   * SYSCALL 17 sys_memmap
+   */
+  regs.a1 = SYSMEM_SWP_OP;
+  regs.a2 = vicfpn;
+  regs.a3 = swpfpn;
+  regs.a4 = swptyp;
+  syscall(krnl, caller->pid, 17, &regs);
+
+  /* Update page table, the victim now lives in swap */
+  pte_set_swap(caller, vicpgn, swptyp, swpfpn);
+
+  *retfpn = vicfpn;
+  return 0;
+}
+
+/*pg_reclaim_one - page out a page of any process
+ *@mram: MEMRAM the frame must be in
+ *@wb: write batch, NULL to write a dirty page now
+ *@retfpn: return the FPN it occupied
+ *
+ * Takes processes round robin, mmvm_lock must be held. Returns as
+ * pg_swapout.
+ */
+static int pg_reclaim_one(struct memphy_struct *mram, struct pg_wbatch *wb,
+                          addr_t *retfpn)
+{
+  struct mm_struct *stuck = NULL; /* first mm that had no victim */
+  int ret;
+
+  while (reclaim_mm != NULL && reclaim_mm != stuck)
+  {
+    struct mm_struct *mm = reclaim_mm;
+    struct pcb_t *owner = mm->owner;
+
+    reclaim_mm = mm->rcl_next;
+    if (owner->krnl->mram == mram &&
+        (ret = pg_swapout(owner, wb, retfpn)) >= 0)
+      return ret;
+    if (stuck == NULL)
+      stuck = mm;
+  }
+  return -1;
+}
+
+/*pg_getframe - get a free frame in MEMRAM
+ *@caller: caller
+ *@retfpn: return FPN
+ *
+ * When MEMRAM is full, one of the caller's pages is paged out to the
+ * active swap device and its frame is handed over instead, or one of
+ * another process if the caller has none in RAM. kswapd is woken early
+ * enough that this should rarely happen.
+ */
+static int pg_getframe(struct pcb_t *caller, addr_t *retfpn)
+{
+  struct krnl_t *krnl = caller->krnl;
+
+  if (MEMPHY_get_freefp(krnl->mram, retfpn) == 0)
+  {
+    kswapd_wakeup(krnl->mram);
+    return 0;
+  }
+
+  kswapd_wakeup(krnl->mram);
+  if (pg_swapout(caller, NULL, retfpn) != 0 &&
+      pg_reclaim_one(krnl->mram, NULL, retfpn) != 0)
+    return -1;
+
+  g_paging_stats.direct_reclaim++;
+  return 0;
+}
+
 /*pg_getpage - get the page in ram
  *@mm: memory region
  *@pagenum: PGN
@@ -219,53 +458,90 @@ printf("%s:%d\n",__func__,__LINE__);
  *@caller: caller
  *
  */
-int pg_getpage(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
+int pg_getpage(struct mm_struct *mm, addr_t pgn, addr_t *fpn, struct pcb_t *caller)
 {
-
+  struct krnl_t *krnl = caller->krnl;
   uint32_t pte = pte_get_entry(caller, pgn);
+  addr_t tgtfpn, swpfpn = 0;
+  int tries, swptyp = -1, uncached = 0, zswapped = 0;
+
+  if (PAGING_PAGE_PRESENT(pte) && !(pte & PAGING_PTE_SWAPPED_MASK))
+  {
+    /* Reference it for the replacement policy */
+    if (!(pte & PAGING_PTE_ACCESSED_MASK))
+      pte_set_accessed(caller, pgn, 1);
+
+    *fpn = PAGING_FPN(pte);
+    return 0;
+  }
+
+  /* Page is not online, make it actively living */
+  g_paging_stats.page_faults++;
 
-  if (!PAGING_PAGE_PRESENT(pte))
-  { /* Page is not online, make it actively living */
-    addr_t vicpgn, swpfpn;
-//    addr_t vicfpn;
-//    addr_t vicpte;
-//  struct sc_regs regs;
+  /* Initialize the target frame storing our variable */
+  if (pg_getframe(caller, &tgtfpn) != 0)
+    return -1;
 
-    /* TODO Initialize the target frame storing our variable */
-//  addr_t tgtfpn 
+  if (PAGING_PAGE_PRESENT(pte))
+  { /* Swapped out earlier: bring it back from zswap or MEMSWP */
+    swpfpn = PAGING_SWP(pte);
+    swptyp = GETVAL(pte, PAGING_PTE_SWPTYP_MASK, PAGING_PTE_SWPTYP_LOBIT);
 
-    /* TODO: Play with your paging theory here */
-    /* Find victim page */
-    if (find_victim_page(caller->krnl->mm, &vicpgn) == -1)
+    if (swptyp == ZSWAP_SWPTYP)
+    { /* The pool copy is dropped once the page is mapped */
+      if (zswap_load(swpfpn, krnl->mram, tgtfpn) != 0)
+      {
+        MEMPHY_put_freefp(krnl->mram, tgtfpn);
+        return -1;
+      }
+      swptyp = -1;
+      zswapped = 1;
+    }
+    else
     {
-      return -1;
+      __swap_cp_page(krnl->mswp[swptyp], swpfpn, krnl->mram, tgtfpn);
+
+      /* Keep the slot while the page stays clean. Without room to
+       * remember it, the slot goes once the page is mapped. */
+      if (swapcache_add(mm->swpcache, pgn, swptyp, swpfpn) != 0)
+        uncached = 1;
     }
+    g_paging_stats.swap_in++;
+  }
+  else
+  { /* First touch of the page */
+    MEMPHY_zero_frame(krnl->mram, tgtfpn);
+  }
 
-    /* Get free frame in MEMSWP */
-    if (MEMPHY_get_freefp(caller->krnl->active_mswp, &swpfpn) == -1)
+  /* Update its online status of the target page. Mapping it may need
+   * page-table frames as well, page out more until they fit. */
+  for (tries = 0; pte_set_fpn(caller, pgn, tgtfpn) != 0; tries++)
+  {
+    addr_t ptfpn;
+
+    if (tries == PG_LEVELS || pg_getframe(caller, &ptfpn) != 0)
     {
+      /* Still swapped out, the PTE owns the slot again */
+      if (swptyp >= 0 && !uncached)
+        swapcache_take(mm->swpcache, pgn, &swptyp, &swpfpn);
+      MEMPHY_put_freefp(krnl->mram, tgtfpn);
       return -1;
     }
+    MEMPHY_put_freefp(krnl->mram, ptfpn);
+  }
 
-    /* TODO: Implement swap frame from MEMRAM to MEMSWP and vice versa*/
-
-    /* TODO copy victim frame to swap 
-     * SWP(vicfpn <--> swpfpn)
-     * SYSCALL 1 sys_memmap
-     */
-
-
-    /* Update page table */
-    //pte_set_swap(...);
-
-    /* Update its online status of the target page */
-    //pte_set_fpn(...);
+  if (zswapped)
+    zswap_free(swpfpn);
+  else if (uncached)
+    MEMPHY_put_freefp(krnl->mswp[swptyp], swpfpn);
 
-    enlist_pgn_node(&caller->krnl->mm->fifo_pgn, pgn);
-  }
+  /* Without a copy in swap it must be written out on eviction */
+  if (uncached || zswapped)
+    pte_set_dirty(caller, pgn, 1);
 
-  *fpn = PAGING_FPN(pte_get_entry(caller,pgn));
+  pgrepl_insert(mm->repl, pgn);
 
+  *fpn = tgtfpn;
   return 0;
 }
 
@@ -275,23 +551,25 @@ int pg_getpage(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
  *@value: value
  *
  */
-int pg_getval(struct mm_struct *mm, int addr, BYTE *data, struct pcb_t *caller)
+int pg_getval(struct mm_struct *mm, addr_t addr, BYTE *data, struct pcb_t *caller)
 {
-  int pgn = PAGING_PGN(addr);
-//  int off = PAGING_OFFST(addr);
-  int fpn;
+  addr_t pgn = PG_PGN(addr);
+  addr_t off = PG_OFFST(addr);
+  addr_t fpn;
+  struct sc_regs regs;
 
+  /* Get the page to MEMRAM, swap from MEMSWAP if needed */
   if (pg_getpage(mm, pgn, &fpn, caller) != 0)
     return -1; /* invalid page access */
 
-//  int phyaddr = (fpn << PAGING_ADDR_FPN_LOBIT) + off;
-
-  /* TODO 
-   *  MEMPHY_read(caller->krnl->mram, phyaddr, data);
-   *  MEMPHY READ 
-   *  SYSCALL 17 sys_memmap with SYSMEM_IO_READ
+  /* MEMPHY READ
+   * SYSCALL 17 sys_memmap with SYSMEM_IO_READ
    */
+  regs.a1 = SYSMEM_IO_READ;
+  regs.a2 = fpn * PG_PAGESZ + off;
+  syscall(caller->krnl, caller->pid, 17, &regs);
 
+  *data = (BYTE)regs.a3;
   return 0;
 }
 
@@ -301,22 +579,34 @@ int pg_getval(struct mm_struct *mm, int addr, BYTE *data, struct pcb_t *caller)
  *@value: value
  *
  */
-int pg_setval(struct mm_struct *mm, int addr, BYTE value, struct pcb_t *caller)
+int pg_setval(struct mm_struct *mm, addr_t addr, BYTE value, struct pcb_t *caller)
 {
-  int pgn = PAGING_PGN(addr);
-//  int off = PAGING_OFFST(addr);
-  int fpn;
+  addr_t pgn = PG_PGN(addr);
+  addr_t off = PG_OFFST(addr);
+  addr_t fpn;
+  struct sc_regs regs;
 
   /* Get the page to MEMRAM, swap from MEMSWAP if needed */
   if (pg_getpage(mm, pgn, &fpn, caller) != 0)
     return -1; /* invalid page access */
 
+  /* First write since it came in: its copy in swap goes stale */
+  if (pte_set_dirty(caller, pgn, 1) == 0)
+  {
+    int swptyp;
+    addr_t swpfpn;
 
-  /* TODO 
-   *  MEMPHY_write(caller->krnl->mram, phyaddr, value);
-   *  MEMPHY WRITE with SYSMEM_IO_WRITE 
+    if (swapcache_take(mm->swpcache, pgn, &swptyp, &swpfpn) == 0)
+      MEMPHY_put_freefp(caller->krnl->mswp[swptyp], swpfpn);
+  }
+
+  /* MEMPHY WRITE with SYSMEM_IO_WRITE
    * SYSCALL 17 sys_memmap
    */
+  regs.a1 = SYSMEM_IO_WRITE;
+  regs.a2 = fpn * PG_PAGESZ + off;
+  regs.a3 = value;
+  syscall(caller->krnl, caller->pid, 17, &regs);
 
   return 0;
 }
@@ -331,15 +621,21 @@ int pg_setval(struct mm_struct *mm, int addr, BYTE value, struct pcb_t *caller)
  */
 int __read(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE *data)
 {
+  pthread_mutex_lock(&mmvm_lock);
   struct vm_rg_struct *currg = get_symrg_byid(caller->krnl->mm, rgid);
 
-//  struct vm_area_struct *cur_vma = get_vma_by_num(caller->krnl->mm, vmaid);
+  struct vm_area_struct *cur_vma = get_vma_by_num(caller->krnl->mm, vmaid);
 
-  /* TODO Invalid memory identify */
+  if (!rg_valid_access(currg, cur_vma, offset)) /* Invalid memory identify */
+  {
+    pthread_mutex_unlock(&mmvm_lock);
+    return -1;
+  }
 
-  pg_getval(caller->krnl->mm, currg->rg_start + offset, data, caller);
+  int val = pg_getval(caller->krnl->mm, currg->rg_start + offset, data, caller);
 
-  return 0;
+  pthread_mutex_unlock(&mmvm_lock);
+  return val;
 }
 
 /*libread - PAGING-based read a region memory */
@@ -378,16 +674,16 @@ int __write(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE value
 
   struct vm_area_struct *cur_vma = get_vma_by_num(caller->krnl->mm, vmaid);
 
-  if (currg == NULL || cur_vma == NULL) /* Invalid memory identify */
+  if (!rg_valid_access(currg, cur_vma, offset)) /* Invalid memory identify */
   {
     pthread_mutex_unlock(&mmvm_lock);
     return -1;
   }
 
-  pg_setval(caller->krnl->mm, currg->rg_start + offset, value, caller);
+  int val = pg_setval(caller->krnl->mm, currg->rg_start + offset, value, caller);
 
   pthread_mutex_unlock(&mmvm_lock);
-  return 0;
+  return val;
 }
 
 /*libwrite - PAGING-based write a region memory */
@@ -412,33 +708,95 @@ int libwrite(
   return val;
 }
 
-/*free_pcb_memphy - collect all memphy of pcb
- *@caller: caller
- *@vmaid: ID vm area to alloc memory region
- *@incpgnum: number of page
+static void reclaim_unlink(struct mm_struct *mm)
+{
+  if (mm->rcl_next == NULL)
+    return; /* never registered */
+
+  if (mm->rcl_next == mm)
+    reclaim_mm = NULL;
+  else
+  {
+    mm->rcl_prev->rcl_next = mm->rcl_next;
+    mm->rcl_next->rcl_prev = mm->rcl_prev;
+    if (reclaim_mm == mm)
+      reclaim_mm = mm->rcl_next;
+  }
+  mm->rcl_prev = mm->rcl_next = NULL;
+}
+
+/*pg_reclaim_add - let reclaim take pages of a process
+ *@proc: process, its mm is set up by init_mm
+ *
  */
-int free_pcb_memph(struct pcb_t *caller)
+void pg_reclaim_add(struct pcb_t *proc)
 {
-  pthread_mutex_lock(&mmvm_lock);
-  int pagenum, fpn;
-  uint32_t pte;
+  struct mm_struct *mm = proc->krnl->mm;
 
-  for (pagenum = 0; pagenum < PAGING_MAX_PGN; pagenum++)
+  pthread_mutex_lock(&mmvm_lock);
+  mm->owner = proc;
+  if (reclaim_mm == NULL)
   {
-    pte = caller->krnl->mm->pgd[pagenum];
+    mm->rcl_prev = mm->rcl_next = mm;
+    reclaim_mm = mm;
+  }
+  else
+  { /* Insert behind the cursor, it is visited last */
+    mm->rcl_next = reclaim_mm;
+    mm->rcl_prev = reclaim_mm->rcl_prev;
+    reclaim_mm->rcl_prev->rcl_next = mm;
+    reclaim_mm->rcl_prev = mm;
+  }
+  pthread_mutex_unlock(&mmvm_lock);
+}
 
-    if (PAGING_PAGE_PRESENT(pte))
-    {
-      fpn = PAGING_FPN(pte);
-      MEMPHY_put_freefp(caller->krnl->mram, fpn);
-    }
-    else
-    {
-      fpn = PAGING_SWP(pte);
-      MEMPHY_put_freefp(caller->krnl->active_mswp, fpn);
-    }
+/*pg_reclaim - page out up to nr pages and free their frames
+ *@mram: MEMRAM to free frames in
+ *@nr: number of pages
+ *
+ * Takes one page per process in turn. Dirty pages are gathered and
+ * written to consecutive swap slots together, their frames are freed
+ * once the write is done. Returns the number of frames freed, 0 once
+ * no process has a page left to give.
+ */
+int pg_reclaim(struct memphy_struct *mram, int nr)
+{
+  struct pg_wbatch wb = { .mram = mram };
+  int freed = 0, ret;
+  addr_t fpn;
+
+  pthread_mutex_lock(&mmvm_lock);
+  while (freed < nr)
+  {
+    wb.want = nr - freed;
+    if ((ret = pg_reclaim_one(mram, &wb, &fpn)) < 0)
+      break;
+    if (ret == 0)
+      MEMPHY_put_freefp(mram, fpn);
+    g_paging_stats.kswapd_reclaim++;
+    freed++;
   }
+  pg_wbatch_flush(&wb);
+  pthread_mutex_unlock(&mmvm_lock);
+  return freed;
+}
+
+/*free_pcb_memph - collect all memphy of pcb
+ *@caller: caller, a process that has finished
+ *
+ * Frees its pages in MEMRAM and MEMSWP and its page tables.
+ */
+int free_pcb_memph(struct pcb_t *caller)
+{
+  struct mm_struct *mm = caller->krnl->mm;
 
+  pthread_mutex_lock(&mmvm_lock);
+  reclaim_unlink(mm);
+  free_pgtbl(caller);
+  pgrepl_destroy(mm->repl);
+  mm->repl = NULL;
+  swapcache_destroy(mm->swpcache, caller->krnl->mswp);
+  mm->swpcache = NULL;
   pthread_mutex_unlock(&mmvm_lock);
   return 0;
 }
@@ -449,27 +807,9 @@ int free_pcb_memph(struct pcb_t *caller)
  *@pgn: return page number
  *
  */
-int find_victim_page(struct mm_struct *mm, addr_t *retpgn)
+int find_victim_page(struct pcb_t *caller, addr_t *retpgn)
 {
-  struct pgn_t *pg = mm->fifo_pgn;
-
-  /* TODO: Implement the theorical mechanism to find the victim page */
-  if (!pg)
-  {
-    return -1;
-  }
-  struct pgn_t *prev = NULL;
-  while (pg->pg_next)
-  {
-    prev = pg;
-    pg = pg->pg_next;
-  }
-  *retpgn = pg->pgn;
-  prev->pg_next = NULL;
-
-  free(pg);
-
-  return 0;
+  return pgrepl_evict(caller->krnl->mm->repl, caller, retpgn);
 }
 
 /*get_free_vmrg_area - get a free vm region
@@ -1,105 +1,387 @@
-
 #include "loader.h"
+#include "cpu.h"
+#include "image.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 static uint32_t avail_pid = 1;
 
-#define OPT_CALC	"calc"
-#define OPT_ALLOC	"alloc"
-#define OPT_FREE	"free"
-#define OPT_READ	"read"
-#define OPT_WRITE	"write"
-#define OPT_SYSCALL	"syscall"
-
-static enum ins_opcode_t get_opcode(char * opt) {
-	if (!strcmp(opt, OPT_CALC)) {
-		return CALC;
-	}else if (!strcmp(opt, OPT_ALLOC)) {
-		return ALLOC;
-	}else if (!strcmp(opt, OPT_FREE)) {
-		return FREE;
-	}else if (!strcmp(opt, OPT_READ)) {
-		return READ;
-	}else if (!strcmp(opt, OPT_WRITE)) {
-		return WRITE;
-	}else if (!strcmp(opt, OPT_SYSCALL)) {
-		return SYSCALL;
-	}else{
-		printf("get_opcode return Opcode: %s\n", opt);
-		exit(1);
+/*
+ * Code segment cache
+ *
+ * Processes started from the same file share one read-only code
+ * segment. Entries are keyed by path and by the identity/mtime of the
+ * file, so editing or recompiling a program between two loads gives
+ * the later processes fresh code while the earlier ones keep theirs.
+ * An entry dies with the last process using it.
+ */
+struct code_cache_t {
+	char path[100];
+	dev_t dev;
+	ino_t ino;
+	off_t fsize;
+	struct timespec mtime;
+	struct code_seg_t * code;
+	int refcnt;
+	int stale;		/* superseded, no longer handed out */
+	struct code_cache_t * next;
+};
+
+static struct code_cache_t * code_cache = NULL;
+static pthread_mutex_t code_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int cache_match(const struct code_cache_t * ent, const char * path,
+		       const struct stat * st) {
+	return !ent->stale &&
+	       ent->dev == st->st_dev && ent->ino == st->st_ino &&
+	       ent->fsize == st->st_size &&
+	       ent->mtime.tv_sec == st->st_mtim.tv_sec &&
+	       ent->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+	       strcmp(ent->path, path) == 0;
+}
+
+/* Take a reference on the cached code of [path], NULL on miss */
+static struct code_seg_t * cache_get(const char * path,
+				     const struct stat * st,
+				     uint32_t * priority) {
+	struct code_cache_t * ent;
+	struct code_seg_t * code = NULL;
+
+	pthread_mutex_lock(&code_cache_lock);
+	for (ent = code_cache; ent != NULL; ent = ent->next) {
+		if (cache_match(ent, path, st)) {
+			ent->refcnt++;
+			*priority = ent->code->priority;
+			code = ent->code;
+			break;
+		}
 	}
+	pthread_mutex_unlock(&code_cache_lock);
+
+	return code;
 }
 
-struct pcb_t * load(const char * path) {
+/* Publish freshly loaded [code] with one reference for the caller and
+ * return it. If another loader raced us to the same file, return its
+ * code instead, again with a reference, and the caller drops [code]. */
+static struct code_seg_t * cache_put(const char * path,
+				     const struct stat * st,
+				     struct code_seg_t * code) {
+	struct code_cache_t * ent;
+	struct code_cache_t * nent = malloc(sizeof(struct code_cache_t));
+
+	pthread_mutex_lock(&code_cache_lock);
+	for (ent = code_cache; ent != NULL; ent = ent->next) {
+		if (cache_match(ent, path, st)) {
+			ent->refcnt++;
+			pthread_mutex_unlock(&code_cache_lock);
+			free(nent);
+			return ent->code;
+		}
+		if (!ent->stale && strcmp(ent->path, path) == 0)
+			ent->stale = 1;	/* the file changed under it */
+	}
+
+	if (nent != NULL) {
+		snprintf(nent->path, sizeof(nent->path), "%s", path);
+		nent->dev   = st->st_dev;
+		nent->ino   = st->st_ino;
+		nent->fsize = st->st_size;
+		nent->mtime = st->st_mtim;
+		nent->code  = code;
+		nent->refcnt = 1;
+		nent->stale = 0;
+		nent->next  = code_cache;
+		code_cache  = nent;
+	}
+	code->cache = nent;
+	pthread_mutex_unlock(&code_cache_lock);
+
+	return code;
+}
+
+static void code_free(struct code_seg_t * code) {
+	free(code->dtext);
+	image_unmap(code);
+	free(code);
+}
+
+/* Drop a reference on [code], freeing it with its last user */
+static void code_put(struct code_seg_t * code) {
+	struct code_cache_t * ent = code->cache;
+	struct code_cache_t ** pp;
+
+	if (ent == NULL) {
+		/* never made it into the cache, owned by one process */
+		code_free(code);
+		return;
+	}
+
+	pthread_mutex_lock(&code_cache_lock);
+	if (--ent->refcnt > 0) {
+		pthread_mutex_unlock(&code_cache_lock);
+		return;
+	}
+	for (pp = &code_cache; *pp != NULL; pp = &(*pp)->next) {
+		if (*pp == ent) {
+			*pp = ent->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&code_cache_lock);
+
+	free(ent);
+	code_free(code);
+}
+
+/* Read and decode the code of [path] from the file itself */
+static struct code_seg_t * code_load(const char * path, uint32_t * priority) {
+	struct code_seg_t * code;
+	int ret;
+
+	/* a compiled image is mapped, a text description is parsed */
+	code = (struct code_seg_t*)malloc(sizeof(struct code_seg_t));
+	if (code == NULL)
+		return NULL;
+
+	ret = image_map(path, priority, code);
+	if (ret > 0) {
+		FILE * file;
+		if ((file = fopen(path, "r")) == NULL) {
+			printf("Cannot find process description at '%s'\n", path);
+			free(code);
+			return NULL;
+		}
+		ret = image_parse_text(file, path, priority, code);
+		fclose(file);
+	}
+	if (ret != 0) {
+		printf("Cannot load process at '%s'\n", path);
+		free(code);
+		return NULL;
+	}
+	code->priority = *priority;
+	code->cache = NULL;
+
+	/* Resolve the text into the form executed by the CPU */
+	if (cpu_decode(code) != 0) {
+		printf("Cannot decode process at '%s'\n", path);
+		image_unmap(code);
+		free(code);
+		return NULL;
+	}
+	return code;
+}
+
+/* Build a PCB for [path] without giving it a PID yet */
+static struct pcb_t * load_nopid(const char * path) {
+	struct code_seg_t * code = NULL;
+	uint32_t priority = 0;
+	struct stat st;
+	int cacheable = (stat(path, &st) == 0);
+
+	/* Read process code, shared with earlier loads of the same file */
+	if (cacheable)
+		code = cache_get(path, &st, &priority);
+	if (code == NULL) {
+		code = code_load(path, &priority);
+		if (code == NULL)
+			return NULL;
+		if (cacheable) {
+			struct code_seg_t * shared = cache_put(path, &st, code);
+			if (shared != code) {
+				code_free(code);
+				code = shared;
+				priority = code->priority;
+			}
+		}
+	}
+
 	/* Create new PCB for the new process */
-	struct pcb_t * proc = (struct pcb_t * )malloc(sizeof(struct pcb_t));
-	proc->pid = avail_pid;
-	avail_pid++;
+	struct pcb_t * proc = (struct pcb_t * )calloc(1, sizeof(struct pcb_t));
 	proc->page_table =
 		(struct page_table_t*)malloc(sizeof(struct page_table_t));
 	proc->bp = PAGE_SIZE;
 	proc->pc = 0;
+	proc->q_prev = proc->q_next = NULL;
+	proc->q_list = NULL;
+	proc->priority = priority;
+	proc->code = code;
+	snprintf(proc->path, sizeof(proc->path), "%s", path);
 
-	/* Read process code from file */
-	FILE * file;
-	if ((file = fopen(path, "r")) == NULL) {
-		printf("Cannot find process description at '%s'\n", path);
-		exit(1);		
-	}
-	snprintf(proc->path, 2*sizeof(path)+1, "%s", path);
-	char opcode[10];
-	proc->code = (struct code_seg_t*)malloc(sizeof(struct code_seg_t));
-	fscanf(file, "%u %u", &proc->priority, &proc->code->size);
-	proc->code->text = (struct inst_t*)malloc(
-		sizeof(struct inst_t) * proc->code->size
-	);
-	uint32_t i = 0;
-	char buf[200];
-	for (i = 0; i < proc->code->size; i++) {
-		fscanf(file, "%s", opcode);
-		proc->code->text[i].opcode = get_opcode(opcode);
-		switch(proc->code->text[i].opcode) {
-		case CALC:
-			break;
-		case ALLOC:
-			fscanf(
-				file,
-				"" FORMAT_ARG " " FORMAT_ARG "\n",
-				&proc->code->text[i].arg_0,
-				&proc->code->text[i].arg_1
-			);
-			break;
-		case FREE:
-			fscanf(file, "" FORMAT_ARG "\n", &proc->code->text[i].arg_0);
+	return proc;
+}
+
+static void assign_pid(struct pcb_t * proc) {
+	proc->pid = __atomic_fetch_add(&avail_pid, 1, __ATOMIC_RELAXED);
+}
+
+struct pcb_t * load(const char * path) {
+	struct pcb_t * proc = load_nopid(path);
+
+	if (proc != NULL)
+		assign_pid(proc);
+	return proc;
+}
+
+void unload(struct pcb_t * proc) {
+	if (proc == NULL)
+		return;
+	if (proc->code != NULL)
+		code_put(proc->code);
+	free(proc->page_table);
+	free(proc);
+}
+
+/*
+ * Preloader
+ *
+ * A pool of threads loads the arrivals of a workload ahead of the
+ * simulation so that parsing and decoding stay off the tick barrier.
+ * Workers pull arrivals from the source in order into a ring of
+ * [window] slots, so they never get more than [window] arrivals ahead
+ * of the consumer, which takes them back in the same order. PIDs are
+ * handed out on take, so they follow the arrival order as with load().
+ */
+struct preload_slot_t {
+	struct wl_arrival_t arr;
+	struct pcb_t * proc;
+	int ready;
+};
+
+static struct {
+	struct workload_t * wl;
+	struct preload_slot_t * slot;	/* ring, entry n is slot[n % window] */
+	int window;
+	uint64_t next;		/* next arrival to claim */
+	uint64_t taken;		/* next arrival to take */
+	int exhausted;		/* the source has no more arrivals */
+	int stopping;
+	int nthreads;
+	pthread_t * threads;
+	pthread_mutex_t lock;
+	pthread_cond_t claim_cond;	/* room in the window, or stop */
+	pthread_cond_t ready_cond;	/* an entry finished, or the end */
+} pl = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.claim_cond = PTHREAD_COND_INITIALIZER,
+	.ready_cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void * preload_worker(void * arg) {
+	(void)arg;
+
+	pthread_mutex_lock(&pl.lock);
+	while (1) {
+		while (!pl.stopping && !pl.exhausted &&
+		       pl.next >= pl.taken + pl.window)
+			pthread_cond_wait(&pl.claim_cond, &pl.lock);
+		if (pl.stopping || pl.exhausted)
 			break;
-		case READ:
-		case WRITE:
-			fscanf(
-				file,
-				"" FORMAT_ARG " " FORMAT_ARG " " FORMAT_ARG "\n",
-				&proc->code->text[i].arg_0,
-				&proc->code->text[i].arg_1,
-				&proc->code->text[i].arg_2
-			);
-			break;	
-		case SYSCALL:
-			fgets(buf, sizeof(buf), file);
-			sscanf(buf, "" FORMAT_ARG "" FORMAT_ARG "" FORMAT_ARG "" FORMAT_ARG "",
-			           &proc->code->text[i].arg_0,
-			           &proc->code->text[i].arg_1,
-			           &proc->code->text[i].arg_2,
-			           &proc->code->text[i].arg_3
-			);
+
+		/* sources are not thread safe, pull under the lock */
+		struct preload_slot_t * s = &pl.slot[pl.next % pl.window];
+		if (!workload_next(pl.wl, &s->arr)) {
+			pl.exhausted = 1;
+			pthread_cond_broadcast(&pl.ready_cond);
 			break;
-		default:
-			printf("Opcode: %s\n", opcode);
-			exit(1);
 		}
+		s->ready = 0;
+		pl.next++;
+		pthread_mutex_unlock(&pl.lock);
+
+		struct pcb_t * proc = load_nopid(s->arr.path);
+
+		pthread_mutex_lock(&pl.lock);
+		s->proc = proc;
+		s->ready = 1;
+		pthread_cond_broadcast(&pl.ready_cond);
 	}
-	return proc;
+	pthread_mutex_unlock(&pl.lock);
+	return NULL;
+}
+
+int preload_start(struct workload_t * wl, int nthreads, int window) {
+	int i;
+
+	if (nthreads < 1)
+		nthreads = 1;
+	if (window < 1)
+		window = 1;
+
+	pl.wl = wl;
+	pl.window = window;
+	pl.next = pl.taken = 0;
+	pl.exhausted = pl.stopping = 0;
+	pl.slot = calloc(window, sizeof(struct preload_slot_t));
+	pl.threads = malloc(sizeof(pthread_t) * nthreads);
+	if (pl.slot == NULL || pl.threads == NULL)
+		goto fail;
+
+	pl.nthreads = 0;
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&pl.threads[i], NULL, preload_worker, NULL) != 0)
+			break;
+		pl.nthreads++;
+	}
+	if (pl.nthreads == 0)
+		goto fail;
+	return 0;
+
+fail:
+	free(pl.slot);
+	free(pl.threads);
+	pl.slot = NULL;
+	pl.threads = NULL;
+	return -1;
+}
+
+int preload_take(struct wl_arrival_t * arr, struct pcb_t ** proc) {
+	struct preload_slot_t * s;
+
+	pthread_mutex_lock(&pl.lock);
+	s = &pl.slot[pl.taken % pl.window];
+	while (!(pl.taken < pl.next && s->ready) &&
+	       !(pl.exhausted && pl.taken == pl.next))
+		pthread_cond_wait(&pl.ready_cond, &pl.lock);
+	if (pl.taken == pl.next) {
+		pthread_mutex_unlock(&pl.lock);
+		return 0;
+	}
+	*arr = s->arr;
+	*proc = s->proc;
+	s->proc = NULL;
+	s->ready = 0;
+	pl.taken++;
+	pthread_cond_broadcast(&pl.claim_cond);
+	pthread_mutex_unlock(&pl.lock);
+
+	if (*proc != NULL)
+		assign_pid(*proc);
+	return 1;
 }
 
+void preload_stop(void) {
+	int i;
+
+	pthread_mutex_lock(&pl.lock);
+	pl.stopping = 1;
+	pthread_cond_broadcast(&pl.claim_cond);
+	pthread_mutex_unlock(&pl.lock);
 
+	for (i = 0; i < pl.nthreads; i++)
+		pthread_join(pl.threads[i], NULL);
 
+	/* entries loaded but never taken */
+	for (i = 0; i < pl.window; i++)
+		unload(pl.slot[i].proc);
+
+	free(pl.slot);
+	free(pl.threads);
+	pl.slot = NULL;
+	pl.threads = NULL;
+	pl.nthreads = 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * LZ77 page codec
+ * mm/lz.c
+ */
+
+#include "lz.h"
+#include <string.h>
+#include <stdint.h>
+
+/*
+ * A stream is a run of sequences:
+ *
+ *   token     literal count (high nibble), match length - LZ_MINMATCH (low)
+ *   [length]  rest of the literal count if its nibble is 15: bytes of 255,
+ *             then one below 255, all added up
+ *   literals
+ *   offset    2 bytes little endian, how far back the match starts
+ *   [length]  rest of the match length, as for literals
+ *
+ * The last sequence stops after its literals.
+ */
+
+#define LZ_MINMATCH	4
+#define LZ_HASH_BITS	12
+#define LZ_MAX_OFFSET	0xFFFF
+
+static inline uint32_t read32(const BYTE *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline unsigned int hash4(uint32_t v)
+{
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Append the rest of a length, return the new output size or -1 */
+static int put_len(BYTE *dst, int op, int cap, int len)
+{
+	for (; len >= 255; len -= 255) {
+		if (op >= cap)
+			return -1;
+		dst[op++] = (BYTE)255;
+	}
+	if (op >= cap)
+		return -1;
+	dst[op++] = (BYTE)len;
+	return op;
+}
+
+/* Append a sequence, a final one if [mlen] is 0 */
+static int put_seq(BYTE *dst, int op, int cap, const BYTE *lit, int nlit,
+		   int off, int mlen)
+{
+	int ml = mlen ? mlen - LZ_MINMATCH : 0;
+
+	if (op >= cap)
+		return -1;
+	dst[op++] = (BYTE)(((nlit < 15 ? nlit : 15) << 4) | (ml < 15 ? ml : 15));
+	if (nlit >= 15 && (op = put_len(dst, op, cap, nlit - 15)) < 0)
+		return -1;
+	if (op + nlit > cap)
+		return -1;
+	memcpy(dst + op, lit, nlit);
+	op += nlit;
+
+	if (mlen == 0)
+		return op;
+	if (op + 2 > cap)
+		return -1;
+	dst[op++] = off & 0xFF;
+	dst[op++] = off >> 8;
+	if (ml >= 15 && (op = put_len(dst, op, cap, ml - 15)) < 0)
+		return -1;
+	return op;
+}
+
+/* Read the rest of a length, -1 past the end of the stream */
+static int get_len(const BYTE *src, int *ip, int n, int len)
+{
+	uint8_t b;
+
+	do {
+		if (*ip >= n)
+			return -1;
+		b = (uint8_t)src[(*ip)++];
+		len += b;
+	} while (b == 255);
+	return len;
+}
+
+int lz_compress(const BYTE *src, int n, BYTE *dst, int cap)
+{
+	int table[1 << LZ_HASH_BITS];	/* last position of each hash */
+	int ip = 0, anchor = 0, op = 0;
+
+	memset(table, -1, sizeof(table));
+
+	while (ip + LZ_MINMATCH <= n) {
+		uint32_t v = read32(src + ip);
+		unsigned int h = hash4(v);
+		int ref = table[h], mlen;
+
+		table[h] = ip;
+		if (ref < 0 || ip - ref > LZ_MAX_OFFSET ||
+		    read32(src + ref) != v) {
+			ip++;
+			continue;
+		}
+
+		for (mlen = LZ_MINMATCH;
+		     ip + mlen < n && src[ref + mlen] == src[ip + mlen]; mlen++)
+			;
+		op = put_seq(dst, op, cap, src + anchor, ip - anchor,
+			     ip - ref, mlen);
+		if (op < 0)
+			return -1;
+		ip += mlen;
+		anchor = ip;
+	}
+
+	return put_seq(dst, op, cap, src + anchor, n - anchor, 0, 0);
+}
+
+int lz_decompress(const BYTE *src, int n, BYTE *dst, int cap)
+{
+	int ip = 0, op = 0;
+
+	while (ip < n) {
+		int token = (uint8_t)src[ip++];
+		int len = token >> 4, off;
+
+		if (len == 15 && (len = get_len(src, &ip, n, len)) < 0)
+			return -1;
+		if (ip + len > n || op + len > cap)
+			return -1;
+		memcpy(dst + op, src + ip, len);
+		ip += len;
+		op += len;
+		if (ip == n)
+			break;	/* final sequence */
+
+		if (ip + 2 > n)
+			return -1;
+		off = (uint8_t)src[ip] | (uint8_t)src[ip + 1] << 8;
+		ip += 2;
+		len = token & 15;
+		if (len == 15 && (len = get_len(src, &ip, n, len)) < 0)
+			return -1;
+		len += LZ_MINMATCH;
+		if (off == 0 || off > op || op + len > cap)
+			return -1;
+		/* byte by byte, the match may overlap what it produces */
+		for (; len > 0; len--, op++)
+			dst[op] = dst[op - off];
+	}
+	return op;
+}
@@ -0,0 +1,236 @@
+/*
+ * Host-file backend of MEMPHY
+ * mm/memphy-file.c
+ */
+
+#include "memphy-file.h"
+#include "mm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+struct memphy_io {
+	addr_t off;
+	addr_t len;
+	BYTE *buf;
+	struct memphy_io *next;
+};
+
+struct memphy_file {
+	int fd;
+	/* Writes in submission order; the head stays queued while the
+	 * I/O thread writes it, so reads still find its data */
+	struct memphy_io *head, *tail;
+	int depth;
+	int stopping;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t work;		/* a write was queued */
+	pthread_cond_t room;		/* a write is done */
+};
+
+static uint64_t now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Account [len] bytes moved in [usec] to the swap I/O stats */
+static void io_account(addr_t len, uint64_t usec)
+{
+	__atomic_fetch_add(&g_paging_stats.swap_io_bytes, len,
+			   __ATOMIC_RELAXED);
+	__atomic_fetch_add(&g_paging_stats.swap_io_usec, usec,
+			   __ATOMIC_RELAXED);
+}
+
+static int pwrite_all(int fd, const BYTE *buf, addr_t len, addr_t off)
+{
+	while (len > 0) {
+		ssize_t n = pwrite(fd, buf, len, off);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+		off += n;
+	}
+	return 0;
+}
+
+static int pread_all(int fd, BYTE *buf, addr_t len, addr_t off)
+{
+	while (len > 0) {
+		ssize_t n = pread(fd, buf, len, off);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return -1;
+		if (n == 0) {
+			memset(buf, 0, len);	/* never written */
+			return 0;
+		}
+		buf += n;
+		len -= n;
+		off += n;
+	}
+	return 0;
+}
+
+static void *memphy_io_routine(void *arg)
+{
+	struct memphy_file *f = arg;
+
+	pthread_mutex_lock(&f->lock);
+	for (;;) {
+		struct memphy_io *io;
+		uint64_t t0;
+
+		while (f->head == NULL && !f->stopping)
+			pthread_cond_wait(&f->work, &f->lock);
+		if (f->head == NULL)
+			break;
+		io = f->head;
+		pthread_mutex_unlock(&f->lock);
+
+		t0 = now_usec();
+		if (pwrite_all(f->fd, io->buf, io->len, io->off) != 0)
+			perror("[MEMPHY] swap file write");
+		io_account(io->len, now_usec() - t0);
+
+		pthread_mutex_lock(&f->lock);
+		f->head = io->next;
+		if (f->head == NULL)
+			f->tail = NULL;
+		f->depth--;
+		pthread_cond_broadcast(&f->room);
+		free(io->buf);
+		free(io);
+	}
+	pthread_mutex_unlock(&f->lock);
+	return NULL;
+}
+
+int memphy_file_open(struct memphy_struct *mp, const char *path)
+{
+	struct memphy_file *f = calloc(1, sizeof(struct memphy_file));
+	char name[PATH_MAX];
+
+	if (f == NULL)
+		return -1;
+
+	/* A unique name, so runs sharing a directory never share a file */
+	if (snprintf(name, sizeof(name), "%s.XXXXXX", path) >=
+	    (int)sizeof(name)) {
+		fprintf(stderr, "%s: swap file name too long\n", path);
+		free(f);
+		return -1;
+	}
+	f->fd = mkstemp(name);
+	if (f->fd < 0) {
+		perror(name);
+		free(f);
+		return -1;
+	}
+	/* Unlinked right away, the space goes back when the simulator
+	 * exits. Sparse, the host only stores what was written. */
+	unlink(name);
+	if (ftruncate(f->fd, mp->maxsz) != 0) {
+		perror(name);
+		close(f->fd);
+		free(f);
+		return -1;
+	}
+
+	pthread_mutex_init(&f->lock, NULL);
+	pthread_cond_init(&f->work, NULL);
+	pthread_cond_init(&f->room, NULL);
+	if (pthread_create(&f->thread, NULL, memphy_io_routine, f) != 0) {
+		pthread_cond_destroy(&f->room);
+		pthread_cond_destroy(&f->work);
+		pthread_mutex_destroy(&f->lock);
+		close(f->fd);
+		free(f);
+		return -1;
+	}
+
+	mp->file = f;
+	return 0;
+}
+
+int memphy_file_read(struct memphy_struct *mp, addr_t off,
+		     BYTE *buf, addr_t len)
+{
+	struct memphy_file *f = mp->file;
+	struct memphy_io *io;
+	uint64_t t0;
+	int rc;
+
+	pthread_mutex_lock(&f->lock);
+	t0 = now_usec();
+	rc = pread_all(f->fd, buf, len, off);
+	io_account(len, now_usec() - t0);
+
+	/* Queued writes are newer than the file, oldest first */
+	for (io = f->head; rc == 0 && io != NULL; io = io->next) {
+		addr_t lo = off > io->off ? off : io->off;
+		addr_t hi = off + len < io->off + io->len ?
+			    off + len : io->off + io->len;
+
+		if (lo < hi)
+			memcpy(buf + (lo - off), io->buf + (lo - io->off),
+			       hi - lo);
+	}
+	pthread_mutex_unlock(&f->lock);
+	return rc;
+}
+
+int memphy_file_submit(struct memphy_struct *mp, addr_t off,
+		       BYTE *buf, addr_t len)
+{
+	struct memphy_file *f = mp->file;
+	struct memphy_io *io = malloc(sizeof(struct memphy_io));
+
+	if (io == NULL) {
+		free(buf);
+		return -1;
+	}
+	io->off = off;
+	io->len = len;
+	io->buf = buf;
+	io->next = NULL;
+
+	pthread_mutex_lock(&f->lock);
+	while (f->depth >= MEMPHY_IO_DEPTH)
+		pthread_cond_wait(&f->room, &f->lock);
+	if (f->tail != NULL)
+		f->tail->next = io;
+	else
+		f->head = io;
+	f->tail = io;
+	f->depth++;
+	pthread_cond_signal(&f->work);
+	pthread_mutex_unlock(&f->lock);
+	return 0;
+}
+
+void memphy_file_sync(struct memphy_struct *mp)
+{
+	struct memphy_file *f = mp->file;
+
+	pthread_mutex_lock(&f->lock);
+	while (f->depth > 0)
+		pthread_cond_wait(&f->room, &f->lock);
+	pthread_mutex_unlock(&f->lock);
+}
@@ -0,0 +1,48 @@
+/*
+ * mkimage - compile a text process description into a binary image
+ *
+ *   mkimage <input> <output>
+ *
+ * The image can be listed in a configuration in place of the text
+ * description, the loader maps it instead of parsing it.
+ */
+
+#include "image.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char * argv[]) {
+	struct code_seg_t code;
+	uint32_t priority;
+	FILE * in;
+	FILE * out;
+
+	if (argc != 3) {
+		printf("Usage: %s <input> <output>\n", argv[0]);
+		return 1;
+	}
+
+	if ((in = fopen(argv[1], "r")) == NULL) {
+		printf("Cannot find process description at '%s'\n", argv[1]);
+		return 1;
+	}
+	if (image_parse_text(in, argv[1], &priority, &code) != 0) {
+		fclose(in);
+		return 1;
+	}
+	fclose(in);
+
+	if ((out = fopen(argv[2], "wb")) == NULL) {
+		perror(argv[2]);
+		return 1;
+	}
+	if (image_write(out, priority, &code) != 0 || fclose(out) != 0) {
+		printf("Cannot write image '%s'\n", argv[2]);
+		return 1;
+	}
+
+	printf("%s: %u instructions, priority %u\n",
+	       argv[2], code.size, priority);
+	image_unmap(&code);
+	return 0;
+}
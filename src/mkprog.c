@@ -0,0 +1,400 @@
+/*
+ * mkprog - generate a synthetic process for paging experiments
+ *
+ *   mkprog [options] <output>
+ *
+ *   -n N          instructions (default 1000)
+ *   -p PRIO       default priority (default 0)
+ *   -r N          memory regions, 1..NUM_REGS-1 (default 4)
+ *   -s SIZE       bytes per region, K/M suffixes allowed (default 64K)
+ *   -m C:R:W:F    weights of calc, read, write and free+alloc churn
+ *                 (default 1:4:4:0)
+ *   -a PATTERN    access pattern over the regions (default seq)
+ *                   seq[:step]        sequential, step bytes apart
+ *                   stride[:step]     sequential, default a page apart
+ *                   random            uniform over every byte
+ *                   zipf[:theta]      Zipfian over pages (default 0.99)
+ *                   ws[:pages:len]    uniform over a working set of
+ *                                     [pages] pages that moves every
+ *                                     [len] accesses (default 16:1000)
+ *   -S SEED       random seed (default 1)
+ *   -b            write a compiled image instead of a text description
+ *
+ * The regions are laid out back to back and the pattern walks them as
+ * one address range, so a pattern crosses region boundaries freely.
+ * The same options and seed always produce the same program.
+ */
+
+#include "image.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Page size of the MM64 paging the programs are aimed at */
+#define MKPROG_PAGESZ	4096
+
+enum pattern_t {
+	PAT_SEQ,
+	PAT_RANDOM,
+	PAT_ZIPF,
+	PAT_WS,
+};
+
+struct gen_t {
+	uint64_t rng;
+	enum pattern_t pat;
+	uint64_t span;		/* bytes over all regions */
+	uint64_t npages;
+	uint64_t cursor;	/* seq: next offset */
+	uint64_t step;		/* seq: distance between accesses */
+	double theta;		/* zipf: skew */
+	double *cdf;		/* zipf: cumulative rank probabilities */
+	uint64_t *perm;		/* zipf: rank -> page, spreads hot pages */
+	uint64_t ws_pages;	/* ws: pages in the working set */
+	uint64_t ws_len;	/* ws: accesses per phase */
+	uint64_t ws_base;	/* ws: first page of the current set */
+	uint64_t ws_left;	/* ws: accesses left in the phase */
+};
+
+/* xorshift64*, reproducible across hosts */
+static uint64_t gen_rand(struct gen_t *g)
+{
+	g->rng ^= g->rng >> 12;
+	g->rng ^= g->rng << 25;
+	g->rng ^= g->rng >> 27;
+	return g->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static double gen_unit(struct gen_t *g)
+{
+	return (gen_rand(g) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int zipf_init(struct gen_t *g)
+{
+	uint64_t i;
+	double sum = 0;
+
+	g->cdf = malloc(sizeof(double) * g->npages);
+	g->perm = malloc(sizeof(uint64_t) * g->npages);
+	if (g->cdf == NULL || g->perm == NULL)
+		return -1;
+
+	for (i = 0; i < g->npages; i++) {
+		sum += 1.0 / pow((double)(i + 1), g->theta);
+		g->cdf[i] = sum;
+		g->perm[i] = i;
+	}
+	for (i = 0; i < g->npages; i++)
+		g->cdf[i] /= sum;
+
+	/* shuffle so the hottest pages are not all adjacent */
+	for (i = g->npages - 1; i > 0; i--) {
+		uint64_t j = gen_rand(g) % (i + 1);
+		uint64_t t = g->perm[i];
+
+		g->perm[i] = g->perm[j];
+		g->perm[j] = t;
+	}
+	return 0;
+}
+
+static uint64_t zipf_page(struct gen_t *g)
+{
+	double u = gen_unit(g);
+	uint64_t lo = 0, hi = g->npages - 1;
+
+	while (lo < hi) {
+		uint64_t mid = lo + (hi - lo) / 2;
+
+		if (g->cdf[mid] < u)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return g->perm[lo];
+}
+
+/* Next byte offset into the regions */
+static uint64_t next_offset(struct gen_t *g)
+{
+	uint64_t off;
+
+	switch (g->pat) {
+	case PAT_SEQ:
+		off = g->cursor;
+		g->cursor = (g->cursor + g->step) % g->span;
+		return off;
+	case PAT_RANDOM:
+		return gen_rand(g) % g->span;
+	case PAT_ZIPF:
+		return zipf_page(g) * MKPROG_PAGESZ +
+		       gen_rand(g) % MKPROG_PAGESZ;
+	case PAT_WS:
+		if (g->ws_left == 0) {
+			g->ws_base = gen_rand(g) % (g->npages - g->ws_pages + 1);
+			g->ws_left = g->ws_len;
+		}
+		g->ws_left--;
+		return (g->ws_base + gen_rand(g) % g->ws_pages) * MKPROG_PAGESZ +
+		       gen_rand(g) % MKPROG_PAGESZ;
+	}
+	return 0;
+}
+
+static int parse_size(const char *s, uint64_t *out)
+{
+	char *end;
+	unsigned long long v = strtoull(s, &end, 0);
+
+	if (end == s)
+		return -1;
+	if (*end == 'K' || *end == 'k')
+		v <<= 10, end++;
+	else if (*end == 'M' || *end == 'm')
+		v <<= 20, end++;
+	if (*end != '\0' || v == 0)
+		return -1;
+	*out = v;
+	return 0;
+}
+
+static int parse_pattern(const char *s, struct gen_t *g)
+{
+	const char *arg = strchr(s, ':');
+	size_t len = arg ? (size_t)(arg - s) : strlen(s);
+
+	if (arg)
+		arg++;
+	if (!strncmp(s, "seq", len) && len == 3) {
+		g->pat = PAT_SEQ;
+		g->step = 1;
+		return arg ? parse_size(arg, &g->step) : 0;
+	}
+	if (!strncmp(s, "stride", len) && len == 6) {
+		g->pat = PAT_SEQ;
+		g->step = MKPROG_PAGESZ;
+		return arg ? parse_size(arg, &g->step) : 0;
+	}
+	if (!strncmp(s, "random", len) && len == 6) {
+		g->pat = PAT_RANDOM;
+		return arg ? -1 : 0;
+	}
+	if (!strncmp(s, "zipf", len) && len == 4) {
+		g->pat = PAT_ZIPF;
+		g->theta = arg ? atof(arg) : 0.99;
+		return g->theta > 0 ? 0 : -1;
+	}
+	if (!strncmp(s, "ws", len) && len == 2) {
+		unsigned long pages = 16, plen = 1000;
+
+		g->pat = PAT_WS;
+		if (arg && sscanf(arg, "%lu:%lu", &pages, &plen) < 1)
+			return -1;
+		g->ws_pages = pages;
+		g->ws_len = plen;
+		return (pages > 0 && plen > 0) ? 0 : -1;
+	}
+	return -1;
+}
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [-n insts] [-p prio] [-r regions] [-s size] "
+	       "[-m calc:read:write:free] [-a pattern] [-S seed] [-b] "
+	       "<output>\n", prog);
+}
+
+static int write_text(FILE *out, uint32_t priority,
+		      const struct code_seg_t *code)
+{
+	static const char *name[] = {
+		[CALC] = "calc", [ALLOC] = "alloc", [FREE] = "free",
+		[READ] = "read", [WRITE] = "write",
+	};
+	uint32_t i;
+
+	fprintf(out, "%u %u\n", priority, code->size);
+	for (i = 0; i < code->size; i++) {
+		const struct inst_t *in = &code->text[i];
+
+		switch (in->opcode) {
+		case CALC:
+			fprintf(out, "%s\n", name[CALC]);
+			break;
+		case FREE:
+			fprintf(out, "%s %lu\n", name[FREE],
+				(unsigned long)in->arg_0);
+			break;
+		case ALLOC:
+			fprintf(out, "%s %lu %lu\n", name[ALLOC],
+				(unsigned long)in->arg_0,
+				(unsigned long)in->arg_1);
+			break;
+		default:
+			fprintf(out, "%s %lu %lu %lu\n", name[in->opcode],
+				(unsigned long)in->arg_0,
+				(unsigned long)in->arg_1,
+				(unsigned long)in->arg_2);
+			break;
+		}
+	}
+	return ferror(out) ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct gen_t g;
+	struct code_seg_t code;
+	uint64_t ninst = 1000, regsz = 64 << 10;
+	unsigned int w[4] = { 1, 4, 4, 0 };
+	unsigned int wsum;
+	int nregs = 4, binary = 0;
+	uint32_t priority = 0;
+	uint32_t i;
+	FILE *out;
+	int opt;
+
+	memset(&g, 0, sizeof(g));
+	g.pat = PAT_SEQ;
+	g.step = 1;
+	g.rng = 1;
+
+	while ((opt = getopt(argc, argv, "n:p:r:s:m:a:S:b")) != -1) {
+		switch (opt) {
+		case 'n':
+			if (parse_size(optarg, &ninst) != 0)
+				goto bad;
+			break;
+		case 'p':
+			priority = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			nregs = atoi(optarg);
+			if (nregs < 1 || nregs > NUM_REGS - 1)
+				goto bad;
+			break;
+		case 's':
+			if (parse_size(optarg, &regsz) != 0)
+				goto bad;
+			break;
+		case 'm':
+			if (sscanf(optarg, "%u:%u:%u:%u",
+				   &w[0], &w[1], &w[2], &w[3]) != 4)
+				goto bad;
+			break;
+		case 'a':
+			if (parse_pattern(optarg, &g) != 0)
+				goto bad;
+			break;
+		case 'S':
+			g.rng = strtoull(optarg, NULL, 0);
+			if (g.rng == 0)
+				g.rng = 1;
+			break;
+		case 'b':
+			binary = 1;
+			break;
+		default:
+			goto bad;
+		}
+	}
+	if (optind != argc - 1)
+		goto bad;
+
+	wsum = w[0] + w[1] + w[2] + w[3];
+	if (wsum == 0 || ninst < (uint64_t)nregs || ninst > UINT32_MAX)
+		goto bad;
+
+	g.span = regsz * nregs;
+	g.npages = (g.span + MKPROG_PAGESZ - 1) / MKPROG_PAGESZ;
+	g.cursor = 0;
+	if (g.pat == PAT_WS && g.ws_pages > g.npages)
+		g.ws_pages = g.npages;
+	if (g.pat == PAT_ZIPF && zipf_init(&g) != 0) {
+		perror("mkprog");
+		return 1;
+	}
+
+	memset(&code, 0, sizeof(code));
+	code.size = ninst;
+	code.text = calloc(ninst, sizeof(struct inst_t));
+	if (code.text == NULL) {
+		perror("mkprog");
+		return 1;
+	}
+
+	/* Allocate every region up front, then run the mix. The last
+	 * register is the destination of reads. */
+	for (i = 0; i < (uint32_t)nregs; i++) {
+		code.text[i].opcode = ALLOC;
+		code.text[i].arg_0 = regsz;
+		code.text[i].arg_1 = i;
+	}
+	for (; i < code.size; i++) {
+		struct inst_t *in = &code.text[i];
+		unsigned int pick = gen_rand(&g) % wsum;
+		uint64_t off;
+
+		if (pick < w[0]) {
+			in->opcode = CALC;
+			continue;
+		}
+		pick -= w[0];
+
+		if (pick >= w[1] + w[2]) {
+			/* churn: drop a region and allocate it again */
+			int reg = gen_rand(&g) % nregs;
+
+			in->opcode = FREE;
+			in->arg_0 = reg;
+			if (i + 1 < code.size) {
+				in++, i++;
+				in->opcode = ALLOC;
+				in->arg_0 = regsz;
+				in->arg_1 = reg;
+			}
+			continue;
+		}
+
+		off = next_offset(&g);
+		if (off >= g.span)
+			off %= g.span;
+		if (pick < w[1]) {
+			in->opcode = READ;
+			in->arg_0 = off / regsz;
+			in->arg_1 = off % regsz;
+			in->arg_2 = NUM_REGS - 1;
+		} else {
+			in->opcode = WRITE;
+			in->arg_0 = gen_rand(&g) & 0x7f;
+			in->arg_1 = off / regsz;
+			in->arg_2 = off % regsz;
+		}
+	}
+
+	if ((out = fopen(argv[optind], binary ? "wb" : "w")) == NULL) {
+		perror(argv[optind]);
+		return 1;
+	}
+	if ((binary ? image_write(out, priority, &code)
+		    : write_text(out, priority, &code)) != 0 ||
+	    fclose(out) != 0) {
+		printf("Cannot write program '%s'\n", argv[optind]);
+		return 1;
+	}
+
+	printf("%s: %u instructions, %d regions of %lu bytes (%lu pages)\n",
+	       argv[optind], code.size, nregs, (unsigned long)regsz,
+	       (unsigned long)g.npages);
+	free(code.text);
+	free(g.cdf);
+	free(g.perm);
+	return 0;
+
+bad:
+	usage(argv[0]);
+	return 1;
+}
@@ -3,10 +3,17 @@
  * Memory physical module mm/mm-memphy.c
  */
 
+#ifdef MM64
+#include "mm64.h"
+#else
 #include "mm.h"
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "memphy-file.h"
 
 #ifdef IODUMP
 #define IOLOG(fmt, ...) \
@@ -15,22 +22,61 @@
 #define IOLOG(fmt, ...) do {} while (0)
 #endif
 
+/*
+ * Frame bitmap helpers: one bit per frame, packed into host words.
+ * A set bit means the frame is in use.
+ */
+#define FP_BITS_PER_WORD (sizeof(unsigned long) * 8)
+#define FP_WORD(fpn)     ((fpn) / FP_BITS_PER_WORD)
+#define FP_MASK(fpn)     (1UL << ((fpn) % FP_BITS_PER_WORD))
+#define FP_USED(mp, fpn) ((mp)->fp_bitmap[FP_WORD(fpn)] & FP_MASK(fpn))
+
+/*
+ *  fp_touch - note that frames may no longer be zero
+ *  @mp: memphy struct
+ *  @addr: first byte written
+ *  @len: bytes written
+ *
+ *  Storage starts out zero-filled by the host; a frame never written
+ *  needs no clearing before first use.
+ */
+static inline void fp_touch(struct memphy_struct *mp, addr_t addr, addr_t len)
+{
+   addr_t fpn, last;
+
+   if (mp->fp_touched == NULL || len == 0)
+      return;
+
+   last = (addr + len - 1) / mp->pagesz;
+   for (fpn = addr / mp->pagesz; fpn <= last; fpn++)
+      __atomic_fetch_or(&mp->fp_touched[FP_WORD(fpn)], FP_MASK(fpn),
+                        __ATOMIC_RELAXED);
+}
+
 /*
  *  MEMPHY_mv_csr - move MEMPHY cursor
  *  @mp: memphy struct
  *  @offset: offset
+ *
+ *  The head travels straight from where the last access left it. The
+ *  distance covered and the time it would take (a settle cost plus a
+ *  cost per KB, see mm.h) are added to the paging stats.
  */
 int MEMPHY_mv_csr(struct memphy_struct *mp, addr_t offset)
 {
-   int numstep = 0;
-
-   mp->cursor = 0;
-   while (numstep < offset && numstep < mp->maxsz)
-   {
-      /* Traverse sequentially */
-      mp->cursor = (mp->cursor + 1) % mp->maxsz;
-      numstep++;
+   addr_t pos = offset < (addr_t)mp->maxsz ? offset : 0;
+   addr_t cur = mp->cursor;
+   addr_t dist = pos > cur ? pos - cur : cur - pos;
+
+   if (dist > 0) {
+      __atomic_fetch_add(&g_paging_stats.seek_count, 1, __ATOMIC_RELAXED);
+      __atomic_fetch_add(&g_paging_stats.seek_bytes, dist, __ATOMIC_RELAXED);
+      __atomic_fetch_add(&g_paging_stats.seek_nsec,
+                         MEMPHY_SEEK_SETTLE_NS +
+                         dist * MEMPHY_SEEK_NS_PER_KB / 1024,
+                         __ATOMIC_RELAXED);
    }
+   mp->cursor = pos;
 
    return 0;
 }
@@ -50,7 +96,7 @@ int MEMPHY_seq_read(struct memphy_struct *mp, addr_t addr, BYTE *value)
       return -1;
 
    MEMPHY_mv_csr(mp, addr);
-   *value = (BYTE)mp->storage[mp->cursor];
+   *value = (BYTE)mp->storage[mp->cursor++];
 
    IOLOG("seq_read: addr=%llu value=%u",
          (unsigned long long)addr, (unsigned)*value);
@@ -59,7 +105,7 @@ int MEMPHY_seq_read(struct memphy_struct *mp, addr_t addr, BYTE *value)
 
 int MEMPHY_read(struct memphy_struct *mp, addr_t addr, BYTE *value)
 {
-   if (mp == NULL)
+   if (mp == NULL || addr >= (addr_t)mp->maxsz)
       return -1;
 
    if (mp->rdmflg) {
@@ -89,7 +135,8 @@ int MEMPHY_seq_write(struct memphy_struct *mp, addr_t addr, BYTE value)
       return -1;  /* random device cannot use seq write */
 
    MEMPHY_mv_csr(mp, addr);
-   mp->storage[mp->cursor] = value;
+   mp->storage[mp->cursor++] = value;
+   fp_touch(mp, addr, 1);
 
    IOLOG("seq_write: addr=%llu value=%u",
          (unsigned long long)addr, (unsigned)value);
@@ -98,11 +145,12 @@ int MEMPHY_seq_write(struct memphy_struct *mp, addr_t addr, BYTE value)
 
 int MEMPHY_write(struct memphy_struct *mp, addr_t addr, BYTE data)
 {
-   if (mp == NULL)
+   if (mp == NULL || addr >= (addr_t)mp->maxsz)
       return -1;
 
    if (mp->rdmflg) {
       mp->storage[addr] = data;
+      fp_touch(mp, addr, 1);
       IOLOG("write: rdm addr=%llu value=%u",
             (unsigned long long)addr, (unsigned)data);
    } else {
@@ -112,38 +160,359 @@ int MEMPHY_write(struct memphy_struct *mp, addr_t addr, BYTE data)
    return 0;
 }
 
+/*
+ *  MEMPHY_block - locate a block of MEMPHY storage
+ *  @mp: memphy struct
+ *  @addr: first byte of the block
+ *  @len: block length
+ *
+ *  Bounds are checked once for the whole block. On a sequential device
+ *  the cursor is moved to @addr once and left past the block, which is
+ *  then accessed contiguously from there.
+ */
+static BYTE *MEMPHY_block(struct memphy_struct *mp, addr_t addr, addr_t len)
+{
+   if (mp == NULL || mp->storage == NULL)
+      return NULL;
+
+   if (addr > (addr_t)mp->maxsz || len > (addr_t)mp->maxsz - addr)
+      return NULL;
+
+   if (!mp->rdmflg) {
+      MEMPHY_mv_csr(mp, addr);
+      mp->cursor += len;
+   }
+
+   return &mp->storage[addr];
+}
+
+/*
+ *  MEMPHY_read32 / MEMPHY_write32 - little-endian 32-bit word access
+ *  @mp: memphy struct
+ *  @addr: address of the first byte
+ *  @value: word read / written
+ */
+int MEMPHY_read32(struct memphy_struct *mp, addr_t addr, uint32_t *value)
+{
+   unsigned char *p = (unsigned char *)MEMPHY_block(mp, addr, 4);
+   if (p == NULL)
+      return -1;
+
+   *value = (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+            ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+
+   IOLOG("read32: addr=%llu value=%#x", (unsigned long long)addr, *value);
+   return 0;
+}
+
+int MEMPHY_write32(struct memphy_struct *mp, addr_t addr, uint32_t value)
+{
+   unsigned char *p = (unsigned char *)MEMPHY_block(mp, addr, 4);
+   if (p == NULL)
+      return -1;
+
+   p[0] = value & 0xFF;
+   p[1] = (value >> 8) & 0xFF;
+   p[2] = (value >> 16) & 0xFF;
+   p[3] = (value >> 24) & 0xFF;
+   fp_touch(mp, addr, 4);
+
+   IOLOG("write32: addr=%llu value=%#x", (unsigned long long)addr, value);
+   return 0;
+}
+
+/*
+ *  MEMPHY_read64 / MEMPHY_write64 - little-endian 64-bit word access
+ */
+int MEMPHY_read64(struct memphy_struct *mp, addr_t addr, uint64_t *value)
+{
+   unsigned char *p = (unsigned char *)MEMPHY_block(mp, addr, 8);
+   if (p == NULL)
+      return -1;
+
+   uint64_t v = 0;
+   for (int i = 7; i >= 0; i--)
+      v = (v << 8) | p[i];
+   *value = v;
+
+   IOLOG("read64: addr=%llu value=%#llx",
+         (unsigned long long)addr, (unsigned long long)v);
+   return 0;
+}
+
+int MEMPHY_write64(struct memphy_struct *mp, addr_t addr, uint64_t value)
+{
+   unsigned char *p = (unsigned char *)MEMPHY_block(mp, addr, 8);
+   if (p == NULL)
+      return -1;
+
+   for (int i = 0; i < 8; i++)
+      p[i] = (value >> (i * 8)) & 0xFF;
+   fp_touch(mp, addr, 8);
+
+   IOLOG("write64: addr=%llu value=%#llx",
+         (unsigned long long)addr, (unsigned long long)value);
+   return 0;
+}
+
+/*
+ *  MEMPHY_read_frame - copy a whole frame out of the device
+ *  @mp: memphy struct
+ *  @fpn: frame number
+ *  @buf: destination buffer of mp->pagesz bytes
+ */
+int MEMPHY_read_frame(struct memphy_struct *mp, addr_t fpn, BYTE *buf)
+{
+   if (mp == NULL)
+      return -1;
+
+   if (mp->file != NULL)
+      return memphy_file_read(mp, fpn * mp->pagesz, buf, mp->pagesz);
+
+   BYTE *p = MEMPHY_block(mp, fpn * mp->pagesz, mp->pagesz);
+   if (p == NULL)
+      return -1;
+
+   memcpy(buf, p, mp->pagesz);
+
+   IOLOG("read_frame: fpn=%llu", (unsigned long long)fpn);
+   return 0;
+}
+
+/*
+ *  MEMPHY_write_frame - copy a whole frame into the device
+ *  @mp: memphy struct
+ *  @fpn: frame number
+ *  @buf: source buffer of mp->pagesz bytes
+ */
+int MEMPHY_write_frame(struct memphy_struct *mp, addr_t fpn, const BYTE *buf)
+{
+   if (mp == NULL)
+      return -1;
+
+   if (mp->file != NULL) {
+      BYTE *copy = malloc(mp->pagesz);
+
+      if (copy == NULL)
+         return -1;
+      memcpy(copy, buf, mp->pagesz);
+      return memphy_file_submit(mp, fpn * mp->pagesz, copy, mp->pagesz);
+   }
+
+   BYTE *p = MEMPHY_block(mp, fpn * mp->pagesz, mp->pagesz);
+   if (p == NULL)
+      return -1;
+
+   memcpy(p, buf, mp->pagesz);
+   fp_touch(mp, fpn * mp->pagesz, mp->pagesz);
+
+   IOLOG("write_frame: fpn=%llu", (unsigned long long)fpn);
+   return 0;
+}
+
+/*
+ *  MEMPHY_zero_frame - clear a whole frame
+ *  @mp: memphy struct
+ *  @fpn: frame number
+ */
+int MEMPHY_zero_frame(struct memphy_struct *mp, addr_t fpn)
+{
+   if (mp == NULL)
+      return -1;
+
+   if (mp->file != NULL) {
+      BYTE *zero = calloc(1, mp->pagesz);
+
+      if (zero == NULL)
+         return -1;
+      return memphy_file_submit(mp, fpn * mp->pagesz, zero, mp->pagesz);
+   }
+
+   BYTE *p = MEMPHY_block(mp, fpn * mp->pagesz, mp->pagesz);
+   if (p == NULL)
+      return -1;
+
+   /* Still as the host handed it out, or written since */
+   if (mp->fp_touched == NULL ||
+       (__atomic_fetch_and(&mp->fp_touched[FP_WORD(fpn)], ~FP_MASK(fpn),
+                           __ATOMIC_RELAXED) & FP_MASK(fpn)))
+      memset(p, 0, mp->pagesz);
+
+   IOLOG("zero_frame: fpn=%llu", (unsigned long long)fpn);
+   return 0;
+}
+
+/*
+ *  MEMPHY_copy_frame - copy a frame between (possibly different) devices
+ *  @mpsrc: source memphy
+ *  @srcfpn: source frame number
+ *  @mpdst: destination memphy
+ *  @dstfpn: destination frame number
+ *
+ *  Both devices must be formatted with the same frame size.
+ */
+int MEMPHY_copy_frame(struct memphy_struct *mpsrc, addr_t srcfpn,
+                      struct memphy_struct *mpdst, addr_t dstfpn)
+{
+   if (mpsrc == NULL || mpdst == NULL || mpsrc->pagesz != mpdst->pagesz)
+      return -1;
+
+   if (mpsrc->file != NULL || mpdst->file != NULL) {
+      /* Through a bounce buffer, the file side has no storage */
+      BYTE *buf = malloc(mpsrc->pagesz);
+      int rc;
+
+      if (buf == NULL)
+         return -1;
+      rc = MEMPHY_read_frame(mpsrc, srcfpn, buf);
+      if (rc == 0)
+         rc = MEMPHY_write_frame(mpdst, dstfpn, buf);
+      free(buf);
+      return rc;
+   }
+
+   BYTE *src = MEMPHY_block(mpsrc, srcfpn * mpsrc->pagesz, mpsrc->pagesz);
+   if (src == NULL)
+      return -1;
+
+   BYTE *dst = MEMPHY_block(mpdst, dstfpn * mpdst->pagesz, mpdst->pagesz);
+   if (dst == NULL)
+      return -1;
+
+   memmove(dst, src, mpdst->pagesz);
+   fp_touch(mpdst, dstfpn * mpdst->pagesz, mpdst->pagesz);
+
+   IOLOG("copy_frame: srcfpn=%llu dstfpn=%llu",
+         (unsigned long long)srcfpn, (unsigned long long)dstfpn);
+   return 0;
+}
+
+/*
+ *  MEMPHY_gather_frames - copy frames to consecutive frames of a device
+ *  @mpsrc: source memphy
+ *  @srcfpn: source frame numbers
+ *  @n: number of frames
+ *  @mpdst: destination memphy
+ *  @dstfpn: first destination frame
+ *
+ *  The destination run is located once and written front to back, so a
+ *  sequential device seeks once for the whole batch.
+ */
+int MEMPHY_gather_frames(struct memphy_struct *mpsrc, const addr_t *srcfpn,
+                         int n, struct memphy_struct *mpdst, addr_t dstfpn)
+{
+   if (mpsrc == NULL || mpdst == NULL || mpsrc->pagesz != mpdst->pagesz ||
+       n <= 0)
+      return -1;
+
+   addr_t len = (addr_t)n * mpdst->pagesz;
+   BYTE *dst;
+
+   if (mpdst->file != NULL) {
+      /* Staged, then queued as one write */
+      dst = malloc(len);
+      if (dst == NULL)
+         return -1;
+   } else {
+      dst = MEMPHY_block(mpdst, dstfpn * mpdst->pagesz, len);
+      if (dst == NULL)
+         return -1;
+   }
+
+   for (int i = 0; i < n; i++) {
+      BYTE *src = MEMPHY_block(mpsrc, srcfpn[i] * mpsrc->pagesz,
+                               mpsrc->pagesz);
+      if (src == NULL) {
+         if (mpdst->file != NULL)
+            free(dst);
+         return -1;
+      }
+      memcpy(dst + (addr_t)i * mpdst->pagesz, src, mpdst->pagesz);
+   }
+
+   if (mpdst->file != NULL) {
+      if (memphy_file_submit(mpdst, dstfpn * mpdst->pagesz, dst, len) != 0)
+         return -1;
+   } else {
+      fp_touch(mpdst, dstfpn * mpdst->pagesz, len);
+   }
+
+   IOLOG("gather_frames: n=%d dstfpn=%llu", n, (unsigned long long)dstfpn);
+   return 0;
+}
+
+/* Protects the frame bitmaps of every MEMPHY device */
+static pthread_mutex_t memphy_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#if SWAP_CLUSTER > 64 || (SWAP_CLUSTER & (SWAP_CLUSTER - 1)) != 0
+#error "SWAP_CLUSTER must be a power of two of at most 64"
+#endif
+
 /*
  *  MEMPHY_format - format MEMPHY device
  *  @mp: memphy struct
+ *  @pagesz: frame size
  */
 int MEMPHY_format(struct memphy_struct *mp, int pagesz)
 {
    int numfp = mp->maxsz / pagesz;
-   struct framephy_struct *newfst, *fst;
-   int iter = 0;
+   int nwords = DIV_ROUND_UP(numfp, FP_BITS_PER_WORD);
 
    if (numfp <= 0)
       return -1;
 
-   fst = malloc(sizeof(struct framephy_struct));
-   fst->fpn = iter;
-   fst->fp_next = NULL;
-   mp->free_fp_list = fst;
+   mp->fp_bitmap = calloc(nwords, sizeof(unsigned long));
+   if (mp->fp_bitmap == NULL)
+      return -1;
 
-   for (iter = 1; iter < numfp; iter++) {
-      newfst = malloc(sizeof(struct framephy_struct));
-      newfst->fpn = iter;
-      newfst->fp_next = NULL;
-      fst->fp_next = newfst;
-      fst = newfst;
+   /* Only devices in host memory start zero-filled */
+   if (mp->storage != NULL) {
+      mp->fp_touched = calloc(nwords, sizeof(unsigned long));
+      if (mp->fp_touched == NULL) {
+         free(mp->fp_bitmap);
+         mp->fp_bitmap = NULL;
+         return -1;
+      }
    }
 
-   mp->used_fp_list = NULL;
+   /* Bits past the last frame are marked used so the scan never returns them */
+   if (numfp % FP_BITS_PER_WORD)
+      mp->fp_bitmap[nwords - 1] = ~0UL << (numfp % FP_BITS_PER_WORD);
+
+   mp->pagesz  = pagesz;
+   mp->numfp   = numfp;
+   mp->freefp  = numfp;
+   mp->fp_hint = 0;
+   mp->clu_next = mp->clu_end = 0;
 
    IOLOG("format: maxsz=%d pagesz=%d numfp=%d", mp->maxsz, pagesz, numfp);
    return 0;
 }
 
+/* Take the first free frame from the hint on, memphy_lock held */
+static void fp_alloc_locked(struct memphy_struct *mp, addr_t *retfpn)
+{
+    /* Scan word by word starting at the hint, wrapping around once */
+    int nwords = DIV_ROUND_UP(mp->numfp, FP_BITS_PER_WORD);
+    int widx = mp->fp_hint;
+    int iter;
+
+    for (iter = 0; iter < nwords; iter++) {
+        if (~mp->fp_bitmap[widx] != 0UL)
+            break;
+        widx = (widx + 1 == nwords) ? 0 : widx + 1;
+    }
+
+    unsigned long word = mp->fp_bitmap[widx];
+    int bit = __builtin_ctzl(~word);
+
+    mp->fp_bitmap[widx] = word | (1UL << bit);
+    mp->freefp--;
+    mp->fp_hint = widx;
+
+    *retfpn = (addr_t)widx * FP_BITS_PER_WORD + bit;
+}
+
 int MEMPHY_get_freefp(struct memphy_struct *mp, addr_t *retfpn)
 {
     if (mp == NULL) {
@@ -151,27 +520,123 @@ int MEMPHY_get_freefp(struct memphy_struct *mp, addr_t *retfpn)
         return -1;
     }
 
-    struct framephy_struct *fp = mp->free_fp_list;
+    if (mp->fp_bitmap == NULL)
+        return -1;
+
+    pthread_mutex_lock(&memphy_lock);
 
-    if (fp == NULL)
+    if (mp->freefp == 0) {
+        pthread_mutex_unlock(&memphy_lock);
         return -1;
+    }
 
-    *retfpn = fp->fpn;
-    mp->free_fp_list = fp->fp_next;
+    fp_alloc_locked(mp, retfpn);
+
+    pthread_mutex_unlock(&memphy_lock);
 
     IOLOG("get_freefp: fpn=%llu",
           (unsigned long long)*retfpn);
-
-    free(fp);
     return 0;
 }
 
+/* Make the next entirely free cluster after the current one current,
+ * memphy_lock held */
+static int fp_next_cluster(struct memphy_struct *mp)
+{
+    int nclusters = DIV_ROUND_UP(mp->numfp, FP_BITS_PER_WORD) *
+                    (FP_BITS_PER_WORD / SWAP_CLUSTER);
+    int start = mp->clu_end / SWAP_CLUSTER;
+    unsigned long mask = (SWAP_CLUSTER == FP_BITS_PER_WORD) ?
+                         ~0UL : (1UL << SWAP_CLUSTER) - 1;
+    int i;
+
+    for (i = 0; i < nclusters; i++) {
+        int c = (start + i) % nclusters;
+        int first = c * SWAP_CLUSTER;
+
+        /* frames past the last one are marked used, never picked */
+        if (mp->fp_bitmap[FP_WORD(first)] &
+            (mask << (first % FP_BITS_PER_WORD)))
+            continue;
+
+        mp->clu_next = first;
+        mp->clu_end  = first + SWAP_CLUSTER;
+        return 0;
+    }
+    return -1;
+}
+
+/*
+ *  MEMPHY_get_cluster - claim up to @n consecutive free frames
+ *  @mp: memphy struct
+ *  @n: frames wanted
+ *  @retfpn: first frame claimed
+ *
+ *  Frames come from the current cluster, an aligned run of SWAP_CLUSTER
+ *  frames that was entirely free when it was picked, so successive calls
+ *  fill the device front to back. Once no free cluster is left a single
+ *  frame is taken wherever one is free. Return the number of frames
+ *  claimed, 0 if the device is full.
+ */
+int MEMPHY_get_cluster(struct memphy_struct *mp, int n, addr_t *retfpn)
+{
+    int k = 0;
+
+    if (mp == NULL || mp->fp_bitmap == NULL || n <= 0)
+        return 0;
+
+    pthread_mutex_lock(&memphy_lock);
+
+    if (mp->freefp == 0) {
+        pthread_mutex_unlock(&memphy_lock);
+        return 0;
+    }
+
+    /* skip frames of the cluster taken one by one meanwhile */
+    while (mp->clu_next < mp->clu_end && FP_USED(mp, mp->clu_next))
+        mp->clu_next++;
+
+    if (mp->clu_next < mp->clu_end || fp_next_cluster(mp) == 0) {
+        *retfpn = mp->clu_next;
+        while (k < n && mp->clu_next < mp->clu_end &&
+               !FP_USED(mp, mp->clu_next)) {
+            mp->fp_bitmap[FP_WORD(mp->clu_next)] |= FP_MASK(mp->clu_next);
+            mp->clu_next++;
+            k++;
+        }
+        mp->freefp -= k;
+    } else {
+        fp_alloc_locked(mp, retfpn);
+        k = 1;
+    }
+
+    pthread_mutex_unlock(&memphy_lock);
+
+    IOLOG("get_cluster: fpn=%llu n=%d", (unsigned long long)*retfpn, k);
+    return k;
+}
+
 int MEMPHY_put_freefp(struct memphy_struct *mp, addr_t fpn)
 {
-   struct framephy_struct *newnode = malloc(sizeof(struct framephy_struct));
-   newnode->fpn = fpn;
-   newnode->fp_next = mp->free_fp_list;
-   mp->free_fp_list = newnode;
+   if (mp == NULL || mp->fp_bitmap == NULL || fpn >= (addr_t)mp->numfp)
+      return -1;
+
+   pthread_mutex_lock(&memphy_lock);
+
+   if (!(mp->fp_bitmap[FP_WORD(fpn)] & FP_MASK(fpn))) {
+      /* Double free: the frame is already on the free bitmap */
+      pthread_mutex_unlock(&memphy_lock);
+      return -1;
+   }
+
+   mp->fp_bitmap[FP_WORD(fpn)] &= ~FP_MASK(fpn);
+   mp->freefp++;
+
+   /* Keep allocations packed towards low frames */
+   if ((int)FP_WORD(fpn) < mp->fp_hint)
+      mp->fp_hint = FP_WORD(fpn);
+
+   pthread_mutex_unlock(&memphy_lock);
 
    IOLOG("put_freefp: fpn=%llu", (unsigned long long)fpn);
    return 0;
@@ -186,6 +651,8 @@ int MEMPHY_dump(struct memphy_struct *mp)
    }
 
    printf("[MEMPHY] dump: maxsz=%d rdmflg=%d\n", mp->maxsz, mp->rdmflg);
+   if (mp->storage == NULL)
+      return 0; /* file backed */
    int limit = mp->maxsz < 256 ? mp->maxsz : 256;
    for (int i = 0; i < limit; i++) {
       if (i % 16 == 0)
@@ -197,20 +664,55 @@ int MEMPHY_dump(struct memphy_struct *mp)
    return 0;
 }
 
+/*
+ *  memphy_alloc_storage - reserve the storage of a device
+ *  @size: device size
+ *
+ *  Anonymous memory the host zero-fills on first touch, so boot does not
+ *  touch the device and RSS follows the frames actually used.
+ *  MEMPHY_POPULATE prefaults it all instead, MEMPHY_HUGEPAGE asks for
+ *  transparent huge pages (os-cfg.h).
+ */
+static BYTE *memphy_alloc_storage(addr_t size)
+{
+   int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+   BYTE *p;
+
+#ifdef MEMPHY_POPULATE
+   flags |= MAP_POPULATE;
+#endif
+   p = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+   if (p == MAP_FAILED)
+      return NULL;
+
+#if defined(MEMPHY_HUGEPAGE) && defined(MADV_HUGEPAGE)
+   madvise(p, size, MADV_HUGEPAGE);
+#endif
+   return p;
+}
+
 int init_memphy(struct memphy_struct *mp, addr_t max_size, int randomflg)
 {
-   mp->storage = (BYTE *)malloc(max_size * sizeof(BYTE));
+   mp->storage = memphy_alloc_storage(max_size);
    mp->maxsz   = max_size;
 
    if (!mp->storage)
        return -1;
 
-   memset(mp->storage, 0, max_size * sizeof(BYTE));
-
-   mp->free_fp_list = NULL;
-   mp->used_fp_list = NULL;
+   mp->fp_bitmap = NULL;
+   mp->fp_touched = NULL;
+   mp->file = NULL;
 
-   MEMPHY_format(mp, PAGING_PAGESZ);
+   /* Frames must match the page size the MMU maps them with */
+#ifdef MM64
+   if (MEMPHY_format(mp, PAGING64_PAGESZ) != 0) {
+#else
+   if (MEMPHY_format(mp, PAGING_PAGESZ) != 0) {
+#endif
+      munmap(mp->storage, max_size);
+      mp->storage = NULL;
+      return -1;
+   }
 
    mp->rdmflg = (randomflg != 0) ? 1 : 0;
    if (!mp->rdmflg)
@@ -223,3 +725,48 @@ int init_memphy(struct memphy_struct *mp, addr_t max_size, int randomflg)
 
    return 0;
 }
+
+/*
+ *  init_memphy_file - create a device stored in a host file
+ *  @mp: memphy struct
+ *  @max_size: device size
+ *  @path: host file name, a unique suffix is added
+ *
+ *  Only frame operations work on such a device, see memphy-file.h.
+ */
+int init_memphy_file(struct memphy_struct *mp, addr_t max_size,
+                     const char *path)
+{
+   mp->storage   = NULL;
+   mp->maxsz     = max_size;
+   mp->fp_bitmap = NULL;
+   mp->fp_touched = NULL;
+   mp->file      = NULL;
+
+#ifdef MM64
+   if (MEMPHY_format(mp, PAGING64_PAGESZ) != 0)
+#else
+   if (MEMPHY_format(mp, PAGING_PAGESZ) != 0)
+#endif
+      return -1;
+
+   mp->rdmflg = 1;
+   mp->cursor = -1;
+
+   if (memphy_file_open(mp, path) != 0)
+      return -1;
+
+   IOLOG("init_memphy_file: max_size=%llu path=%s",
+         (unsigned long long)max_size, path);
+   return 0;
+}
+
+/*
+ *  MEMPHY_sync - wait for the writes queued on a device
+ *  @mp: memphy struct
+ */
+void MEMPHY_sync(struct memphy_struct *mp)
+{
+   if (mp != NULL && mp->file != NULL)
+      memphy_file_sync(mp);
+}
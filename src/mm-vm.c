@@ -5,6 +5,9 @@
 
 #include "string.h"
 #include "mm.h"
+#ifdef MM64
+#include "mm64.h"
+#endif
 #include <stdlib.h>
 #include <stdio.h>
 #include <pthread.h>
@@ -20,6 +23,14 @@
 /* global kernel object (set up in os.c) */
 extern struct krnl_t os;
 
+/* mm of the calling process, the latest loaded one without a caller */
+static inline struct mm_struct *caller_mm(struct pcb_t *caller)
+{
+    if (caller && caller->krnl)
+        return caller->krnl->mm;
+    return os.mm;
+}
+
 /* __swap_cp_page is implemented in mm64.c / mm.c */
 int __swap_cp_page(struct memphy_struct *mpsrc, addr_t srcfpn,
                    struct memphy_struct *mpdst, addr_t dstfpn);
@@ -45,24 +56,58 @@ struct vm_area_struct *get_vma_by_num(struct mm_struct *mm, int vmaid)
     return pvma;
 }
 
-int __mm_swap_page(struct pcb_t *caller, addr_t vicfpn, addr_t swpfpn)
+/* MEMSWP device [swptyp] of the caller, NULL if it has none */
+static struct memphy_struct *swap_dev(struct krnl_t *krnl, int swptyp)
+{
+    if (!krnl->mswp || swptyp < 0 || swptyp >= PAGING_MAX_MMSWP)
+        return NULL;
+    return krnl->mswp[swptyp];
+}
+
+int __mm_swap_page(struct pcb_t *caller, addr_t vicfpn, addr_t swpfpn,
+                   int swptyp)
 {
-    (void)caller;  /* we only need global os.mram / os.active_mswp */
+    struct krnl_t *krnl = (caller && caller->krnl) ? caller->krnl : &os;
+    struct memphy_struct *mswp = swap_dev(krnl, swptyp);
 
-    if (!os.mram || !os.active_mswp) {
-        MMLOG("__mm_swap_page: mram or active_mswp is NULL");
+    if (!krnl->mram || !mswp) {
+        MMLOG("__mm_swap_page: mram or mswp[%d] is NULL", swptyp);
         return -1;
     }
 
-    MMLOG("__mm_swap_page: vicfpn=%llu swpfpn=%llu",
-          (unsigned long long)vicfpn,
+    MMLOG("__mm_swap_page: vicfpn=%llu swptyp=%d swpfpn=%llu",
+          (unsigned long long)vicfpn, swptyp,
           (unsigned long long)swpfpn);
 
     /* RAM -> SWAP (victim out) */
-    int rc = __swap_cp_page(os.mram, vicfpn, os.active_mswp, swpfpn);
+    int rc = __swap_cp_page(krnl->mram, vicfpn, mswp, swpfpn);
     if (rc == 0) {
         /* Count successful swap-out */
         g_paging_stats.swap_out++;
+        g_paging_stats.swap_writes++;
+    }
+    return rc;
+}
+
+int __mm_swap_pages(struct pcb_t *caller, const addr_t *vicfpn, int n,
+                    int swptyp, addr_t swpfpn)
+{
+    struct krnl_t *krnl = (caller && caller->krnl) ? caller->krnl : &os;
+    struct memphy_struct *mswp = swap_dev(krnl, swptyp);
+
+    if (!krnl->mram || !mswp) {
+        MMLOG("__mm_swap_pages: mram or mswp[%d] is NULL", swptyp);
+        return -1;
+    }
+
+    MMLOG("__mm_swap_pages: n=%d swptyp=%d swpfpn=%llu", n, swptyp,
+          (unsigned long long)swpfpn);
+
+    /* RAM -> SWAP, the victims go to n consecutive slots */
+    int rc = MEMPHY_gather_frames(krnl->mram, vicfpn, n, mswp, swpfpn);
+    if (rc == 0) {
+        g_paging_stats.swap_out += n;
+        g_paging_stats.swap_writes++;
     }
     return rc;
 }
@@ -75,12 +120,11 @@ struct vm_rg_struct *get_vm_area_node_at_brk(struct pcb_t *caller,
                                              addr_t size,
                                              addr_t alignedsz)
 {
-    (void)caller;    /* only vmaid + os.mm used here */
     (void)alignedsz; /* kept for interface compatibility */
 
-    struct mm_struct *mm = os.mm;
+    struct mm_struct *mm = caller_mm(caller);
     if (!mm) {
-        MMLOG("get_vm_area_node_at_brk: os.mm == NULL");
+        MMLOG("get_vm_area_node_at_brk: mm == NULL");
         return NULL;
     }
 
@@ -117,7 +161,6 @@ int validate_overlap_vm_area(struct pcb_t *caller,
                              addr_t vmastart,
                              addr_t vmaend)
 {
-    (void)caller; /* we validate against all VMAs in os.mm */
     (void)vmaid;  /* no per-vma restriction */
 
     if (vmastart >= vmaend) {
@@ -127,9 +170,10 @@ int validate_overlap_vm_area(struct pcb_t *caller,
         return -1;
     }
 
-    struct mm_struct *mm = os.mm;
+    /* validate against all VMAs of the caller */
+    struct mm_struct *mm = caller_mm(caller);
     if (!mm) {
-        MMLOG("validate_overlap_vm_area: os.mm == NULL");
+        MMLOG("validate_overlap_vm_area: mm == NULL");
         return -1;
     }
 
@@ -157,9 +201,9 @@ int inc_vma_limit(struct pcb_t *caller, int vmaid, addr_t inc_sz)
     if (inc_sz == 0)
         return 0;
 
-    struct mm_struct *mm = os.mm;
+    struct mm_struct *mm = caller_mm(caller);
     if (!mm) {
-        MMLOG("inc_vma_limit: os.mm == NULL (PID=%u)",
+        MMLOG("inc_vma_limit: mm == NULL (PID=%u)",
               caller ? caller->pid : 0);
         return -1;
     }
@@ -170,9 +214,14 @@ int inc_vma_limit(struct pcb_t *caller, int vmaid, addr_t inc_sz)
         return -1;
     }
 
-    /* align request to page size */
+    /* align request to the page size the MMU maps */
+#ifdef MM64
+    addr_t aligned = PAGING64_PAGE_ALIGNSZ(inc_sz);
+    int incnumpage = (int)(aligned / PAGING64_PAGESZ);
+#else
     addr_t aligned = PAGING_PAGE_ALIGNSZ(inc_sz);
     int incnumpage = (int)(aligned / PAGING_PAGESZ);
+#endif
     if (incnumpage <= 0)
         return 0;
 
@@ -199,31 +248,18 @@ int inc_vma_limit(struct pcb_t *caller, int vmaid, addr_t inc_sz)
         return -1;
     }
 
-    addr_t old_end = cur_vma->sbrk;
-
-    /* map virtual range to physical frames */
-    if (vm_map_ram(caller,
-                   area->rg_start,
-                   area->rg_end,
-                   old_end,
-                   incnumpage,
-                   area) < 0) {
-        MMLOG("inc_vma_limit: vm_map_ram failed");
-        free(area);
-        return -1;
-    }
+    /* Frames are not mapped here: each page gets one on its first
+     * touch (see pg_getpage), so the range may exceed MEMRAM */
 
     /* update vma break and end */
     cur_vma->sbrk = area->rg_end;
     if (cur_vma->sbrk > cur_vma->vm_end)
         cur_vma->vm_end = cur_vma->sbrk;
+    free(area);
 
     MMLOG("inc_vma_limit: new sbrk=%llu vm_end=%llu",
           (unsigned long long)cur_vma->sbrk,
           (unsigned long long)cur_vma->vm_end);
 
-    /* NOTE: if you keep a free-region list per VMA, you can enlist area
-       there; if not needed, area can be kept only as a mapping descriptor. */
-
     return 0;
 }
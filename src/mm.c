@@ -277,6 +277,24 @@ int print_pgtbl(struct pcb_t *caller, uint32_t start, uint32_t end)
   printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
 }
+
+int pte_set_accessed(struct pcb_t *caller, addr_t pgn, int accessed)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  return -1;
+}
+
+int pte_set_dirty(struct pcb_t *caller, addr_t pgn, int dirty)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  return -1;
+}
+
+int free_pgtbl(struct pcb_t *caller)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  return -1;
+}
 /* ===== Global paging statistics definition & printer ===== */
 
 /* This is the single definition of the global stats variable */
@@ -15,6 +15,10 @@
 
 #include "mm64.h"
 #include "mm.h"
+#include "tlb.h"
+#include "pgrepl.h"
+#include "swapcache.h"
+#include "zswap.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -147,18 +151,19 @@ int pte_set_swap(struct pcb_t *caller, addr_t pgn, int swptyp, addr_t swpoff)
     SETBIT(pte_value, PAGING_PTE_PRESENT_MASK);
     SETBIT(pte_value, PAGING_PTE_SWAPPED_MASK);
     CLRBIT(pte_value, PAGING_PTE_DIRTY_MASK);
+    CLRBIT(pte_value, PAGING_PTE_ACCESSED_MASK);
     SETVAL(pte_value, swptyp, PAGING_PTE_SWPTYP_MASK, PAGING_PTE_SWPTYP_LOBIT);
     SETVAL(pte_value, swpoff, PAGING_PTE_SWPOFF_MASK, PAGING_PTE_SWPOFF_LOBIT);
 
 #ifdef MM64
-    for (int i = 0; i < 4; i++) {
-        BYTE byte_val = (pte_value >> (i * 8)) & 0xFF;
-        MEMPHY_write(mram, pte_addr + i, byte_val);
-    }
+    MEMPHY_write32(mram, pte_addr, (uint32_t)pte_value);
 #else
     krnl->mm->pgd[pgn] = pte_value;
 #endif
 
+#ifdef MM_TLB
+    tlb_invalidate((addr_t)krnl->mm->pgd, pgn);
+#endif
     return 0;
 }
 
@@ -193,6 +198,7 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
             MMLOG("pte_set_fpn: no frame for P4D");
             return -1;
         }
+        MEMPHY_zero_frame(mram, p4d_fpn);
 
         /* count PT memory: one 4KB page for P4D */
         g_paging_stats.pt_bytes += PAGING64_PAGESZ;
@@ -201,10 +207,7 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
         SETBIT(pgd_entry, PAGING_PTE_PRESENT_MASK);
         SETVAL(pgd_entry, p4d_fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
 
-        for (int i = 0; i < 4; i++) {
-            BYTE byte_val = (pgd_entry >> (i * 8)) & 0xFF;
-            MEMPHY_write(mram, pgd_base + pgd_idx * 4 + i, byte_val);
-        }
+        MEMPHY_write32(mram, pgd_base + pgd_idx * 4, (uint32_t)pgd_entry);
     }
 
     addr_t p4d_base = (pgd_entry & 0x1FFF) * PAGING64_PAGESZ;
@@ -217,6 +220,7 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
             MMLOG("pte_set_fpn: no frame for PUD");
             return -1;
         }
+        MEMPHY_zero_frame(mram, pud_fpn);
 
         /* count PT memory: one 4KB page for PUD */
         g_paging_stats.pt_bytes += PAGING64_PAGESZ;
@@ -225,10 +229,7 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
         SETBIT(p4d_entry, PAGING_PTE_PRESENT_MASK);
         SETVAL(p4d_entry, pud_fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
 
-        for (int i = 0; i < 4; i++) {
-            BYTE byte_val = (p4d_entry >> (i * 8)) & 0xFF;
-            MEMPHY_write(mram, p4d_base + p4d_idx * 4 + i, byte_val);
-        }
+        MEMPHY_write32(mram, p4d_base + p4d_idx * 4, (uint32_t)p4d_entry);
     }
 
     addr_t pud_base = (p4d_entry & 0x1FFF) * PAGING64_PAGESZ;
@@ -241,6 +242,7 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
             MMLOG("pte_set_fpn: no frame for PMD");
             return -1;
         }
+        MEMPHY_zero_frame(mram, pmd_fpn);
 
         /* count PT memory: one 4KB page for PMD */
         g_paging_stats.pt_bytes += PAGING64_PAGESZ;
@@ -249,10 +251,7 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
         SETBIT(pud_entry, PAGING_PTE_PRESENT_MASK);
         SETVAL(pud_entry, pmd_fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
 
-        for (int i = 0; i < 4; i++) {
-            BYTE byte_val = (pud_entry >> (i * 8)) & 0xFF;
-            MEMPHY_write(mram, pud_base + pud_idx * 4 + i, byte_val);
-        }
+        MEMPHY_write32(mram, pud_base + pud_idx * 4, (uint32_t)pud_entry);
     }
 
     addr_t pmd_base = (pud_entry & 0x1FFF) * PAGING64_PAGESZ;
@@ -265,6 +264,7 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
             MMLOG("pte_set_fpn: no frame for PT");
             return -1;
         }
+        MEMPHY_zero_frame(mram, pt_fpn);
 
         /* count PT memory: one 4KB page for PT (leaf) */
         g_paging_stats.pt_bytes += PAGING64_PAGESZ;
@@ -273,10 +273,7 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
         SETBIT(pmd_entry, PAGING_PTE_PRESENT_MASK);
         SETVAL(pmd_entry, pt_fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
 
-        for (int i = 0; i < 4; i++) {
-            BYTE byte_val = (pmd_entry >> (i * 8)) & 0xFF;
-            MEMPHY_write(mram, pmd_base + pmd_idx * 4 + i, byte_val);
-        }
+        MEMPHY_write32(mram, pmd_base + pmd_idx * 4, (uint32_t)pmd_entry);
     }
 
     addr_t pt_base = (pmd_entry & 0x1FFF) * PAGING64_PAGESZ;
@@ -291,17 +288,21 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
 
     SETBIT(pte_value, PAGING_PTE_PRESENT_MASK);
     CLRBIT(pte_value, PAGING_PTE_SWAPPED_MASK);
+    /* mapped on a fault, so it is being accessed right now, and it
+     * matches its copy in swap (or is a fresh zero page) */
+    SETBIT(pte_value, PAGING_PTE_ACCESSED_MASK);
+    CLRBIT(pte_value, PAGING_PTE_DIRTY_MASK);
     SETVAL(pte_value, fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
 
 #ifdef MM64
-    for (int i = 0; i < 4; i++) {
-        BYTE byte_val = (pte_value >> (i * 8)) & 0xFF;
-        MEMPHY_write(mram, pte_addr + i, byte_val);
-    }
+    MEMPHY_write32(mram, pte_addr, (uint32_t)pte_value);
 #else
     krnl->mm->pgd[pgn] = pte_value;
 #endif
 
+#ifdef MM_TLB
+    tlb_invalidate((addr_t)krnl->mm->pgd, pgn);
+#endif
     return 0;
 }
 
@@ -351,14 +352,128 @@ int pte_set_entry(struct pcb_t *caller, addr_t pgn, uint32_t pte_val)
     if (get_pte_address(krnl->mm, mram, pgn, &pte_addr) != 0)
         return -1;
 
-    for (int i = 0; i < 4; i++) {
-        BYTE byte_val = (pte_val >> (i * 8)) & 0xFF;
-        MEMPHY_write(mram, pte_addr + i, byte_val);
-    }
+    MEMPHY_write32(mram, pte_addr, (uint32_t)pte_val);
 #else
     krnl->mm->pgd[pgn] = pte_val;
 #endif
 
+#ifdef MM_TLB
+    tlb_invalidate((addr_t)krnl->mm->pgd, pgn);
+#endif
+    return 0;
+}
+
+/*
+ * pte_update_bit - set or clear flag [mask] of a page in RAM, return
+ * its previous value. The TLB does not cache the accessed and dirty
+ * bits, so the entry is updated in place without a shootdown.
+ */
+static int pte_update_bit(struct pcb_t *caller, addr_t pgn,
+                          uint32_t mask, int on)
+{
+    struct krnl_t *krnl = caller->krnl;
+    struct memphy_struct *mram = mm_get_mram(krnl);
+    addr_t pte_addr;
+    uint32_t pte_value;
+    int old;
+
+    if (!mram)
+        return -1;
+
+#ifdef MM64
+    if (get_pte_address(krnl->mm, mram, pgn, &pte_addr) != 0)
+        return -1;
+    pte_value = (uint32_t)get_32bit_entry(pte_addr, mram);
+#else
+    pte_addr  = (addr_t)&krnl->mm->pgd[pgn];
+    pte_value = krnl->mm->pgd[pgn];
+#endif
+
+    if (!(pte_value & PAGING_PTE_PRESENT_MASK) ||
+        (pte_value & PAGING_PTE_SWAPPED_MASK))
+        return -1;
+
+    old = (pte_value & mask) != 0;
+    if (old == !!on)
+        return old;
+
+    if (on)
+        SETBIT(pte_value, mask);
+    else
+        CLRBIT(pte_value, mask);
+
+#ifdef MM64
+    MEMPHY_write32(mram, pte_addr, pte_value);
+#else
+    krnl->mm->pgd[pgn] = pte_value;
+#endif
+    return old;
+}
+
+/*
+ * pte_set_accessed - set or clear the accessed bit of a page in RAM
+ */
+int pte_set_accessed(struct pcb_t *caller, addr_t pgn, int accessed)
+{
+    return pte_update_bit(caller, pgn, PAGING_PTE_ACCESSED_MASK, accessed);
+}
+
+/*
+ * pte_set_dirty - set or clear the dirty bit of a page in RAM
+ */
+int pte_set_dirty(struct pcb_t *caller, addr_t pgn, int dirty)
+{
+    return pte_update_bit(caller, pgn, PAGING_PTE_DIRTY_MASK, dirty);
+}
+
+/*
+ * free_pgtbl_level - free a page table, the tables below it and, from
+ * the leaf tables, the pages they map in MEMRAM or swap
+ */
+static void free_pgtbl_level(struct krnl_t *krnl, addr_t fpn, int level)
+{
+    struct memphy_struct *mram = krnl->mram;
+    addr_t base = fpn * PAGING64_PAGESZ;
+    int i;
+
+    for (i = 0; i < PAGING64_PTRS_PER_TBL; i++) {
+        addr_t entry = get_32bit_entry(base + i * 4, mram);
+
+        if (!(entry & PAGING_PTE_PRESENT_MASK))
+            continue;
+
+        if (level > 1) {
+            free_pgtbl_level(krnl, entry & 0x1FFF, level - 1);
+        } else if (entry & PAGING_PTE_SWAPPED_MASK) {
+            int swptyp = PAGING_PTE_SWPTYP_MASK & entry;
+
+            if (swptyp == ZSWAP_SWPTYP)
+                zswap_free(PAGING_SWP(entry));
+            else if (krnl->mswp[swptyp] != NULL)
+                MEMPHY_put_freefp(krnl->mswp[swptyp], PAGING_SWP(entry));
+        } else {
+            MEMPHY_put_freefp(mram, entry & 0x1FFF);
+        }
+    }
+    MEMPHY_put_freefp(mram, fpn);
+}
+
+/*
+ * free_pgtbl - release every frame and swap slot of the caller's mm
+ */
+int free_pgtbl(struct pcb_t *caller)
+{
+    struct krnl_t *krnl = caller->krnl;
+    struct mm_struct *mm = krnl->mm;
+
+    if (!mm_get_mram(krnl))
+        return -1;
+
+#ifdef MM_TLB
+    tlb_flush_asid((addr_t)mm->pgd);
+#endif
+    free_pgtbl_level(krnl, (addr_t)mm->pgd / PAGING64_PAGESZ,
+                     PAGING64_LEVELS);
     return 0;
 }
 
@@ -404,7 +519,7 @@ addr_t vmap_page_range(struct pcb_t *caller,
         }
 
 #ifdef MM_PAGING
-        enlist_pgn_node(&krnl->mm->fifo_pgn, pgn);
+        pgrepl_insert(krnl->mm->repl, pgn);
 #endif
     }
 
@@ -523,15 +638,7 @@ addr_t vm_map_ram(struct pcb_t *caller,
 int __swap_cp_page(struct memphy_struct *mpsrc, addr_t srcfpn,
                    struct memphy_struct *mpdst, addr_t dstfpn)
 {
-    for (int cellidx = 0; cellidx < PAGING_PAGESZ; cellidx++) {
-        addr_t addrsrc = srcfpn * PAGING_PAGESZ + cellidx;
-        addr_t addrdst = dstfpn * PAGING_PAGESZ + cellidx;
-
-        BYTE data;
-        MEMPHY_read(mpsrc, addrsrc, &data);
-        MEMPHY_write(mpdst, addrdst, data);
-    }
-    return 0;
+    return MEMPHY_copy_frame(mpsrc, srcfpn, mpdst, dstfpn);
 }
 
 /* ------------------------------------------------------------------ */
@@ -552,9 +659,21 @@ int init_mm(struct mm_struct *mm, struct pcb_t *caller)
     if (!vma0)
         return -1;
 
+    mm->rcl_prev = mm->rcl_next = NULL; /* not on the reclaim list yet */
+    mm->repl = pgrepl_create();
+    mm->swpcache = swapcache_create();
+    if (!mm->repl || !mm->swpcache) {
+        pgrepl_destroy(mm->repl);
+        swapcache_destroy(mm->swpcache, NULL);
+        free(vma0);
+        return -1;
+    }
+
 #ifdef MM64
     addr_t pgd_fpn;
     if (MEMPHY_get_freefp(mram, &pgd_fpn) != 0) {
+        pgrepl_destroy(mm->repl);
+        swapcache_destroy(mm->swpcache, NULL);
         free(vma0);
         return -1;
     }
@@ -564,10 +683,7 @@ int init_mm(struct mm_struct *mm, struct pcb_t *caller)
 
     mm->pgd = (addr_t *)(pgd_fpn * PAGING64_PAGESZ);
 
-    addr_t pgd_base = (addr_t)mm->pgd;
-    for (int i = 0; i < PAGING64_PAGESZ; i++) {
-        MEMPHY_write(mram, pgd_base + i, 0);
-    }
+    MEMPHY_zero_frame(mram, pgd_fpn);
 
     mm->p4d = NULL;
     mm->pud = NULL;
@@ -576,6 +692,8 @@ int init_mm(struct mm_struct *mm, struct pcb_t *caller)
 #else
     addr_t pgd_fpn32;
     if (MEMPHY_get_freefp(mram, &pgd_fpn32) != 0) {
+        pgrepl_destroy(mm->repl);
+        swapcache_destroy(mm->swpcache, NULL);
         free(vma0);
         return -1;
     }
@@ -585,13 +703,9 @@ int init_mm(struct mm_struct *mm, struct pcb_t *caller)
 
     mm->pgd = (uint32_t *)(pgd_fpn32 * PAGING_PAGESZ);
 
-    addr_t pgd_base32 = (addr_t)mm->pgd;
-    for (int i = 0; i < PAGING_PAGESZ; i++) {
-        MEMPHY_write(mram, pgd_base32 + i, 0);
-    }
+    MEMPHY_zero_frame(mram, pgd_fpn32);
 #endif
 
-    mm->fifo_pgn = NULL;
     memset(mm->symrgtbl, 0, sizeof(struct vm_rg_struct) * PAGING_MAX_SYMTBL_SZ);
 
     vma0->vm_id    = 0;
@@ -600,6 +714,7 @@ int init_mm(struct mm_struct *mm, struct pcb_t *caller)
     vma0->sbrk     = vma0->vm_start;
 
     struct vm_rg_struct *first_rg = init_vm_rg(vma0->vm_start, vma0->vm_end);
+    vma0->vm_freerg_list = NULL;
     enlist_vm_rg_node(&vma0->vm_freerg_list, first_rg);
 
     vma0->vm_next = NULL;
@@ -717,13 +832,9 @@ int print_pgtbl(struct pcb_t *caller, addr_t start, addr_t end)
 
 addr_t get_32bit_entry(addr_t base_address, struct memphy_struct *mp)
 {
-    addr_t entry = 0;
-    for (int i = 0; i < 4; i++) {
-        BYTE byte_val;
-        if (MEMPHY_read(mp, base_address + i, &byte_val) != 0)
-            return (addr_t)-1;
-        entry |= ((addr_t)byte_val) << (i * 8);
-    }
+    uint32_t entry;
+    if (MEMPHY_read32(mp, base_address, &entry) != 0)
+        return (addr_t)-1;
     return entry;
 }
 
@@ -735,6 +846,14 @@ int translate_address(struct mm_struct *mm,
     /* one logical "page-table lookup" */
     g_paging_stats.mem_access++;
 
+#ifdef MM_TLB
+    struct tlb_entry_t tlbe;
+    if (tlb_lookup((addr_t)mm->pgd, vaddr >> PAGING64_ADDR_PT_SHIFT, &tlbe) == 0) {
+        *paddr = tlbe.fpn * PAGING64_PAGESZ + (vaddr & 0xFFF);
+        return 0;
+    }
+#endif
+
     addr_t pgd, p4d, pud, pmd, pt;
     get_pd_from_address(vaddr, &pgd, &p4d, &pud, &pmd, &pt);
 
@@ -758,6 +877,12 @@ int translate_address(struct mm_struct *mm,
     addr_t pt_entry = get_32bit_entry(pt_base + pt * 4, mp);
     if (!(pt_entry & PAGING_PTE_PRESENT_MASK)) return -1;
 
+#ifdef MM_TLB
+    if (!(pt_entry & PAGING_PTE_SWAPPED_MASK))
+        tlb_insert((addr_t)mm->pgd, vaddr >> PAGING64_ADDR_PT_SHIFT,
+                   pt_base + pt * 4, (uint32_t)pt_entry);
+#endif
+
     addr_t fpn       = pt_entry & 0x1FFF;
     addr_t page_base = fpn * PAGING64_PAGESZ;
     addr_t offset    = vaddr & 0xFFF;
@@ -774,6 +899,14 @@ int get_pte_address(struct mm_struct *mm,
     /* one logical page-table access */
     g_paging_stats.mem_access++;
 
+#ifdef MM_TLB
+    struct tlb_entry_t tlbe;
+    if (tlb_lookup((addr_t)mm->pgd, pgn, &tlbe) == 0) {
+        *pte_addr = tlbe.pte_addr;
+        return 0;
+    }
+#endif
+
     addr_t pgd_idx, p4d_idx, pud_idx, pmd_idx, pt_idx;
     get_pd_from_pagenum(pgn, &pgd_idx, &p4d_idx, &pud_idx, &pmd_idx, &pt_idx);
 
@@ -795,6 +928,14 @@ int get_pte_address(struct mm_struct *mm,
     addr_t pt_base = (pmd_entry & 0x1FFF) * PAGING64_PAGESZ;
 
     *pte_addr = pt_base + pt_idx * 4;
+
+#ifdef MM_TLB
+    /* Fill the TLB with the leaf entry if it maps a frame in RAM */
+    addr_t pt_entry = get_32bit_entry(*pte_addr, mp);
+    if ((pt_entry & PAGING_PTE_PRESENT_MASK) &&
+        !(pt_entry & PAGING_PTE_SWAPPED_MASK))
+        tlb_insert((addr_t)mm->pgd, pgn, *pte_addr, (uint32_t)pt_entry);
+#endif
     return 0;
 }
 
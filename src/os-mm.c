@@ -10,7 +10,22 @@ struct paging_stats g_paging_stats;
  *   [STATS] page_faults = <val>
  *   [STATS] swap_in = <val>
  *   [STATS] swap_out = <val>
+ *   [STATS] swap_writes = <val>
+ *   [STATS] swap_io_bytes = <val>
+ *   [STATS] swap_io_usec = <val>
+ *   [STATS] seek_count = <val>
+ *   [STATS] seek_bytes = <val>
+ *   [STATS] seek_nsec = <val>
  *   [STATS] pt_bytes = <val>
+ *   [STATS] tlb_hit = <val>
+ *   [STATS] tlb_miss = <val>
+ *   [STATS] tlb_flush = <val>
+ *   [STATS] kswapd_reclaim = <val>
+ *   [STATS] direct_reclaim = <val>
+ *   [STATS] evict_clean = <val>
+ *   [STATS] zswap_stored = <val>
+ *   [STATS] zswap_same_filled = <val>
+ *   [STATS] zswap_reject = <val>
  */
 void paging_stats_print(void)
 {
@@ -18,6 +33,22 @@ void paging_stats_print(void)
     printf("[STATS] page_faults = %lu\n",  g_paging_stats.page_faults);
     printf("[STATS] swap_in = %lu\n",      g_paging_stats.swap_in);
     printf("[STATS] swap_out = %lu\n",     g_paging_stats.swap_out);
+    printf("[STATS] swap_writes = %lu\n",  g_paging_stats.swap_writes);
+    printf("[STATS] swap_io_bytes = %lu\n", g_paging_stats.swap_io_bytes);
+    printf("[STATS] swap_io_usec = %lu\n", g_paging_stats.swap_io_usec);
+    printf("[STATS] seek_count = %lu\n",   g_paging_stats.seek_count);
+    printf("[STATS] seek_bytes = %lu\n",   g_paging_stats.seek_bytes);
+    printf("[STATS] seek_nsec = %lu\n",    g_paging_stats.seek_nsec);
     printf("[STATS] pt_bytes = %llu\n",
            (unsigned long long)g_paging_stats.pt_bytes);
+    printf("[STATS] tlb_hit = %lu\n",      g_paging_stats.tlb_hit);
+    printf("[STATS] tlb_miss = %lu\n",     g_paging_stats.tlb_miss);
+    printf("[STATS] tlb_flush = %lu\n",    g_paging_stats.tlb_flush);
+    printf("[STATS] kswapd_reclaim = %lu\n", g_paging_stats.kswapd_reclaim);
+    printf("[STATS] direct_reclaim = %lu\n", g_paging_stats.direct_reclaim);
+    printf("[STATS] evict_clean = %lu\n",  g_paging_stats.evict_clean);
+    printf("[STATS] zswap_stored = %lu\n", g_paging_stats.zswap_stored);
+    printf("[STATS] zswap_same_filled = %lu\n",
+           g_paging_stats.zswap_same_filled);
+    printf("[STATS] zswap_reject = %lu\n", g_paging_stats.zswap_reject);
 }
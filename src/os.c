@@ -7,11 +7,20 @@
 #include "sched.h"
 #include "loader.h"
 #include "mm.h"
+#include "tlb.h"
+#include "workload.h"
+#include "pgrepl.h"
+#include "kswapd.h"
+#include "zswap.h"
+#include "swap.h"
+#include "libmem.h"
 
 #include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
 
 /* --------------------------------------------------------------------- */
 /* Debug macros                                                          */
@@ -29,11 +38,22 @@ static int num_cpus;
 static int done = 0;
 struct krnl_t os;
 
+/* MEMSWP device kinds, -s on the command line */
+enum { SWAP_MEM, SWAP_SEQ, SWAP_FILE };
+static const char * const swapkinds[] = { "mem", "seq", "file" };
+
+#ifdef MM_SWAP_FILE
+#define SWAP_FILE_NAME MM_SWAP_FILE
+#else
+#define SWAP_FILE_NAME "/tmp/memswp%d"
+#endif
+
 #ifdef MM_PAGING
 #include "os-mm.h"   /* stats: g_paging_stats, paging_stats_reset/print */
 
 static int memramsz;
 static int memswpsz[PAGING_MAX_MMSWP];
+static int swapprio[PAGING_MAX_MMSWP];
 
 struct mmpaging_ld_args {
     /* A dispatched argument struct to compact many-fields passing to loader */
@@ -46,15 +66,8 @@ struct mmpaging_ld_args {
 };
 #endif
 
-struct ld_args {
-    char ** path;
-    unsigned long * start_time;
-#ifdef MLQ_SCHED
-    unsigned long * prio;
-#endif
-} ld_processes;
-
-int num_processes;
+/* Where process arrivals come from, set up by read_config() */
+static struct workload_t * workload;
 
 struct cpu_args {
     struct timer_id_t * timer_id;
@@ -73,6 +86,7 @@ static void * cpu_routine(void * args)
     int time_left = 0;
     struct pcb_t * proc = NULL;
 
+    cpu_set_current(id);
     OSLOG("CPU %d thread started", id);
 
     while (1) {
@@ -84,15 +98,20 @@ static void * cpu_routine(void * args)
             if (proc == NULL) {
                 OSLOG("CPU %d: no process in ready queue at time %lu",
                       id, current_time());
-                next_slot(timer_id);
-                continue; /* First load failed. skip dummy load */
             }
         } else if (proc->pc == proc->code->size) {
             /* The process has finished its job */
             printf("\tCPU %d: Processed %2d has finished\n",
                    id ,proc->pid);
             OSLOG("CPU %d: freeing PCB PID=%d", id, proc->pid);
-            free(proc);
+            finish_proc(proc);
+            wl_stats_finish(proc->arrival_time, proc->first_run,
+                            current_time());
+#ifdef MM_PAGING
+            free_pcb_memph(proc);
+#endif
+            free(proc->krnl);
+            unload(proc);
             proc = get_proc();
             time_left = 0;
         } else if (time_left == 0) {
@@ -115,7 +134,7 @@ static void * cpu_routine(void * args)
             /* There may be new processes to run in
              * next time slots, just skip current slot */
             OSLOG("CPU %d: idle slot at time %lu", id, current_time());
-            next_slot(timer_id);
+            next_slot_until(timer_id, TIMER_NEVER);
             continue;
         } else if (time_left == 0) {
             printf("\tCPU %d: Dispatched process %2d\n",
@@ -123,6 +142,8 @@ static void * cpu_routine(void * args)
             OSLOG("CPU %d: dispatched PID=%d new time slice=%d",
                   id, proc->pid, time_slot);
             time_left = time_slot;
+            if (proc->first_run == TIMER_NEVER)
+                proc->first_run = current_time();
         }
 
         /* Run current process */
@@ -139,96 +160,145 @@ static void * cpu_routine(void * args)
 /* Loader routine                                                        */
 /* --------------------------------------------------------------------- */
 
-static void * ld_routine(void * args)
+static int loader_threads(void)
 {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (ncpu < 1)
+        ncpu = 1;
+    return ncpu < LOADER_THREADS ? (int)ncpu : LOADER_THREADS;
+}
+
+/* Hand an arrival over to the scheduler */
 #ifdef MM_PAGING
-    struct memphy_struct*  mram        = ((struct mmpaging_ld_args *)args)->mram;
-    struct memphy_struct** mswp        = ((struct mmpaging_ld_args *)args)->mswp;
-    struct memphy_struct*  active_mswp = ((struct mmpaging_ld_args *)args)->active_mswp;
-    struct timer_id_t *    timer_id    = ((struct mmpaging_ld_args *)args)->timer_id;
+static void admit_proc(const struct wl_arrival_t * arr, struct pcb_t * proc,
+                       struct memphy_struct * mram,
+                       struct memphy_struct ** mswp,
+                       struct memphy_struct * active_mswp)
 #else
-    struct timer_id_t * timer_id = (struct timer_id_t*)args;
+static void admit_proc(const struct wl_arrival_t * arr, struct pcb_t * proc)
 #endif
+{
+    if (proc == NULL) {
+        printf("\tSkipped process at %s\n", arr->path);
+        return;
+    }
 
-    int i = 0;
-    printf("ld_routine\n");
-    OSLOG("Loader thread started, num_processes=%d", num_processes);
+    proc->arrival_time = current_time();
+    proc->first_run = TIMER_NEVER;
 
-    while (i < num_processes) {
-        struct pcb_t * proc = load(ld_processes.path[i]);
-        struct krnl_t * krnl = proc->krnl = &os;
+    /* Every process sees the kernel through its own copy of os, so
+     * that the mm installed below stays private to it while the
+     * CPUs keep running other processes */
+    struct krnl_t * krnl = proc->krnl = malloc(sizeof(struct krnl_t));
+    if (!krnl) {
+        perror("malloc krnl_t");
+        exit(1);
+    }
+    *krnl = os;
 
 #ifdef MLQ_SCHED
-        proc->prio = ld_processes.prio[i];
+    proc->prio = (arr->prio == WL_PRIO_DEFAULT) ? proc->priority
+                                                 : (uint32_t)arr->prio;
 #endif
 
-        OSLOG("Loader: loaded image %s as PID=%d, default prio=%u",
-              ld_processes.path[i], proc->pid, proc->priority);
-
-        /* Wait until start_time for this process */
-        while (current_time() < ld_processes.start_time[i]) {
-            OSLOG("Loader: waiting to start PID=%d at time %lu (current=%lu)",
-                  proc->pid,
-                  ld_processes.start_time[i],
-                  current_time());
-            next_slot(timer_id);
-        }
+    OSLOG("Loader: loaded image %s as PID=%d, default prio=%u",
+          arr->path, proc->pid, proc->priority);
 
 #ifdef MM_PAGING
-        /* IMPORTANT: hook kernel memory pointers BEFORE init_mm() */
-        krnl->mram           = mram;
-        krnl->mswp           = mswp;
-        krnl->active_mswp    = active_mswp;
-        krnl->active_mswp_id = 0;
-
-        OSLOG("Loader: kernel mem hooks set: mram=%p mswp=%p active_mswp=%p",
-              (void*)krnl->mram, (void*)krnl->mswp, (void*)krnl->active_mswp);
-
-        krnl->mm = malloc(sizeof(struct mm_struct));
-        if (!krnl->mm) {
-            perror("malloc mm_struct");
-            exit(1);
-        }
+    /* IMPORTANT: hook kernel memory pointers BEFORE init_mm() */
+    krnl->mram           = mram;
+    krnl->mswp           = mswp;
+    krnl->active_mswp    = active_mswp;
+    krnl->active_mswp_id = 0;
+
+    OSLOG("Loader: kernel mem hooks set: mram=%p mswp=%p active_mswp=%p",
+          (void*)krnl->mram, (void*)krnl->mswp, (void*)krnl->active_mswp);
+
+    krnl->mm = malloc(sizeof(struct mm_struct));
+    if (!krnl->mm) {
+        perror("malloc mm_struct");
+        exit(1);
+    }
 
-        OSLOG("Loader: calling init_mm(mm=%p, PID=%d)",
-              (void*)krnl->mm, proc->pid);
+    OSLOG("Loader: calling init_mm(mm=%p, PID=%d)",
+          (void*)krnl->mm, proc->pid);
 
-        if (init_mm(krnl->mm, proc) != 0) {
-            fprintf(stderr, "[OS] init_mm failed for PID=%d\n", proc->pid);
-            exit(1);
-        }
+    if (init_mm(krnl->mm, proc) != 0) {
+        fprintf(stderr, "[OS] init_mm failed for PID=%d\n", proc->pid);
+        exit(1);
+    }
 
-        /* make sure global os.mm is valid for mm-vm.c helpers */
-        os.mm = krnl->mm;
+    /* keep os.mm pointing at the latest mm for callers without a PCB */
+    os.mm = krnl->mm;
+    pg_reclaim_add(proc);
 
-        OSLOG("Loader: init_mm done for PID=%d, mm=%p mram=%p mswp[0]=%p",
-              proc->pid,
-              (void*)krnl->mm,
-              (void*)krnl->mram,
-              (void*)(krnl->mswp ? krnl->mswp[0] : NULL));
+    OSLOG("Loader: init_mm done for PID=%d, mm=%p mram=%p mswp[0]=%p",
+          proc->pid,
+          (void*)krnl->mm,
+          (void*)krnl->mram,
+          (void*)(krnl->mswp ? krnl->mswp[0] : NULL));
 #endif
 
 #ifdef MLQ_SCHED
-        printf("\tLoaded a process at %s, PID: %d PRIO: %lu\n",
-               ld_processes.path[i], proc->pid, ld_processes.prio[i]);
+    printf("\tLoaded a process at %s, PID: %d PRIO: %u\n",
+           arr->path, proc->pid, proc->prio);
 #else
-        printf("\tLoaded a process at %s, PID: %d\n",
-               ld_processes.path[i], proc->pid);
+    printf("\tLoaded a process at %s, PID: %d\n",
+           arr->path, proc->pid);
 #endif
 
-        add_proc(proc);
-        OSLOG("Loader: added PID=%d to ready queue", proc->pid);
+    add_proc(proc);
+    OSLOG("Loader: added PID=%d to ready queue", proc->pid);
+}
 
-        free(ld_processes.path[i]);
-        i++;
-        next_slot(timer_id);
+static void * ld_routine(void * args)
+{
+#ifdef MM_PAGING
+    struct memphy_struct*  mram        = ((struct mmpaging_ld_args *)args)->mram;
+    struct memphy_struct** mswp        = ((struct mmpaging_ld_args *)args)->mswp;
+    struct memphy_struct*  active_mswp = ((struct mmpaging_ld_args *)args)->active_mswp;
+    struct timer_id_t *    timer_id    = ((struct mmpaging_ld_args *)args)->timer_id;
+#else
+    struct timer_id_t * timer_id = (struct timer_id_t*)args;
+#endif
+
+    struct wl_arrival_t arr;
+    struct pcb_t * proc;
+    int more;
+
+    printf("ld_routine\n");
+    OSLOG("Loader thread started");
+
+    /* Programs are parsed by the preload threads meanwhile, this thread
+     * only admits them once their start time has come */
+    if (preload_start(workload, loader_threads(), LOADER_WINDOW) != 0) {
+        fprintf(stderr, "[OS] cannot start the loader threads\n");
+        exit(1);
     }
 
-    free(ld_processes.path);
-    free(ld_processes.start_time);
-#ifdef MLQ_SCHED
-    free(ld_processes.prio);
+    more = preload_take(&arr, &proc);
+    while (more) {
+        /* Wait until start_time of the next process */
+        while (current_time() < arr.start_time) {
+            OSLOG("Loader: waiting to start %s at time %lu (current=%lu)",
+                  arr.path, arr.start_time, current_time());
+            next_slot_until(timer_id, arr.start_time);
+        }
+
+        /* Admit every process that is due in this slot */
+        do {
+#ifdef MM_PAGING
+            admit_proc(&arr, proc, mram, mswp, active_mswp);
+#else
+            admit_proc(&arr, proc);
 #endif
+            more = preload_take(&arr, &proc);
+        } while (more && arr.start_time <= current_time());
+    }
+
+    preload_stop();
+    workload_close(workload);
 
     done = 1;
     OSLOG("Loader: all processes loaded, done=1");
@@ -240,6 +310,62 @@ static void * ld_routine(void * args)
 /* Config reader                                                         */
 /* --------------------------------------------------------------------- */
 
+/* Set up a generated or trace workload from a spec file */
+static void read_workload_spec(FILE * file, const char * path,
+                               const char * kind)
+{
+    struct wl_spec_t spec;
+    enum wl_kind_t wl_kind;
+
+    if (!strcmp(kind, "poisson")) {
+        wl_kind = WL_POISSON;
+    } else if (!strcmp(kind, "bursty")) {
+        wl_kind = WL_BURSTY;
+    } else if (!strcmp(kind, "trace")) {
+        wl_kind = WL_TRACE;
+    } else {
+        printf("%s: unknown workload '%s'\n", path, kind);
+        exit(1);
+    }
+
+    if (workload_read_spec(file, path, wl_kind, &spec) != 0)
+        exit(1);
+
+    time_slot = spec.time_slot;
+    num_cpus  = spec.num_cpus;
+    printf("[CONF] workload=%s time_slice=%d cpus=%d ticks=%lu procs=%lu\n",
+           kind, time_slot, num_cpus,
+           (unsigned long)spec.max_ticks, (unsigned long)spec.max_procs);
+
+#ifdef MM_PAGING
+    int sit;
+
+    memramsz    = 0x10000000;
+    memswpsz[0] = 0x01000000;
+    for (sit = 1; sit < PAGING_MAX_MMSWP; sit++)
+        memswpsz[sit] = 0;
+    if (spec.num_memsz > 0) {
+        memramsz = spec.memsz[0];
+        for (sit = 0; sit < PAGING_MAX_MMSWP; sit++)
+            memswpsz[sit] = (sit + 1 < spec.num_memsz) ? spec.memsz[sit + 1] : 0;
+    }
+    printf("[CONF] RAM=%#x SWP0=%#x\n", memramsz, memswpsz[0]);
+
+    for (sit = 0; sit < spec.num_swap_prio; sit++)
+        swapprio[sit] = spec.swap_prio[sit];
+
+    if (spec.replace[0] != '\0' && pgrepl_select(spec.replace) != 0) {
+        printf("%s: unknown page replacement policy '%s'\n",
+               path, spec.replace);
+        exit(1);
+    }
+#endif
+
+    workload = workload_open(&spec);
+    if (workload == NULL)
+        exit(1);
+}
+
 static void read_config(const char * path)
 {
     FILE * file;
@@ -248,15 +374,27 @@ static void read_config(const char * path)
         exit(1);
     }
 
+    char header[256];
+    char kind[32];
+    int num_processes = 0;
+
+    if (!fgets(header, sizeof(header), file)) {
+        printf("Empty configure file at %s\n", path);
+        exit(1);
+    }
+
+    /* "workload <kind>" starts a workload spec, see workload.h */
+    if (sscanf(header, "workload %31s", kind) == 1) {
+        read_workload_spec(file, path, kind);
+        fclose(file);
+        return;
+    }
+
     /* header: time_slice, num_cpus, num_processes */
-    fscanf(file, "%d %d %d\n", &time_slot, &num_cpus, &num_processes);
+    sscanf(header, "%d %d %d", &time_slot, &num_cpus, &num_processes);
     printf("[CONF] time_slice=%d cpus=%d procs=%d\n",
            time_slot, num_cpus, num_processes);
 
-    ld_processes.path = (char**)malloc(sizeof(char*) * num_processes);
-    ld_processes.start_time =
-        (unsigned long*)malloc(sizeof(unsigned long) * num_processes);
-
 #ifdef MM_PAGING
     int sit;
 
@@ -321,46 +459,16 @@ static void read_config(const char * path)
     }
 #endif /* MM_PAGING */
 
-#ifdef MLQ_SCHED
-    ld_processes.prio =
-        (unsigned long*)malloc(sizeof(unsigned long) * num_processes);
-#endif
-
-    /* --- Process lines --- */
-    int i;
-    for (i = 0; i < num_processes; i++) {
-        ld_processes.path[i] = (char*)malloc(sizeof(char) * 100);
-        ld_processes.path[i][0] = '\0';
-        strcat(ld_processes.path[i], "input/proc/");
-
-        char proc[100];
-#ifdef MLQ_SCHED
-        fscanf(file, "%lu %s %lu\n",
-               &ld_processes.start_time[i],
-               proc,
-               &ld_processes.prio[i]);
-#else
-        fscanf(file, "%lu %s\n",
-               &ld_processes.start_time[i],
-               proc);
-#endif
-        strcat(ld_processes.path[i], proc);
-
-#ifdef MLQ_SCHED
-        printf("[CONF] proc[%d]: start=%lu path=%s prio=%lu\n",
-               i,
-               ld_processes.start_time[i],
-               ld_processes.path[i],
-               ld_processes.prio[i]);
-#else
-        printf("[CONF] proc[%d]: start=%lu path=%s\n",
-               i,
-               ld_processes.start_time[i],
-               ld_processes.path[i]);
-#endif
+    /* The process lines are streamed to the loader as a trace */
+    workload = workload_trace(file, "input/proc/", 1);
+    if (workload == NULL) {
+        printf("Cannot read processes of %s\n", path);
+        exit(1);
     }
-
-    fclose(file);
+    /* max_procs 0 means no limit, so an empty process list has to
+     * stop the trace by itself */
+    workload->max_procs = num_processes;
+    workload->done = num_processes <= 0;
 }
 
 
@@ -370,19 +478,67 @@ static void read_config(const char * path)
 
 int main(int argc, char * argv[])
 {
-    /* Read config */
-    if (argc != 2) {
-        printf("Usage: os [path to configure file]\n");
-        return 1;
+    const char * policy = NULL;
+    int opt;
+#ifdef MM_ZSWAP
+    long zswapsz = ZSWAP_POOL_SIZE;
+#else
+    long zswapsz = 0;
+#endif
+#if defined(MM_SWAP_FILE)
+    int swapkind = SWAP_FILE;
+#elif defined(MM_SWAP_SEQ)
+    int swapkind = SWAP_SEQ;
+#else
+    int swapkind = SWAP_MEM;
+#endif
+
+    while ((opt = getopt(argc, argv, "p:z:s:")) != -1) {
+        switch (opt) {
+        case 'p':
+            policy = optarg;
+            break;
+        case 'z':
+            zswapsz = atol(optarg);
+            if (zswapsz < 0)
+                goto usage;
+            break;
+        case 's':
+            for (swapkind = SWAP_FILE; swapkind >= 0; swapkind--)
+                if (!strcmp(optarg, swapkinds[swapkind]))
+                    break;
+            if (swapkind < 0)
+                goto usage;
+            break;
+        default:
+            goto usage;
+        }
     }
 
+    /* Read config */
+    if (optind != argc - 1)
+        goto usage;
+
     char path[256];
     path[0] = '\0';
     strcat(path, "input/");
-    strcat(path, argv[1]);
+    strcat(path, argv[optind]);
 
     read_config(path);
 
+#ifdef MM_PAGING
+    /* The command line wins over the policy of a workload spec */
+    if (policy != NULL && pgrepl_select(policy) != 0) {
+        printf("Unknown page replacement policy '%s' (one of: %s)\n",
+               policy, pgrepl_names());
+        return 1;
+    }
+    printf("[BOOT] page replacement: %s\n", pgrepl_name());
+#endif
+
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
 #ifdef MM_PAGING
     /* Reset paging statistics at the beginning of each run */
     paging_stats_reset();
@@ -414,7 +570,11 @@ int main(int argc, char * argv[])
         (struct memphy_struct**)malloc(sizeof(struct memphy_struct*) * PAGING_MAX_MMSWP);
 
     /* Create MEM RAM */
-    init_memphy(mram, memramsz, rdmflag);
+    if (init_memphy(mram, memramsz, rdmflag) != 0) {
+        fprintf(stderr, "[BOOT] cannot create MEMRAM of size %#x, "
+                "it must hold at least one page\n", memramsz);
+        exit(1);
+    }
     printf("[BOOT] init MEMRAM size=%#x\n", memramsz);
 
     /* Create all MEM SWAP */
@@ -423,15 +583,58 @@ int main(int argc, char * argv[])
         if (memswpsz[sit] > 0) {
             mswp[sit] =
                 (struct memphy_struct*)malloc(sizeof(struct memphy_struct));
-            init_memphy(mswp[sit], memswpsz[sit], rdmflag);
-            printf("[BOOT] init MEMSWP[%d] size=%#x\n",
-                   sit, memswpsz[sit]);
+            if (swapkind == SWAP_FILE) {
+                char swpfile[64];
+
+                snprintf(swpfile, sizeof(swpfile), SWAP_FILE_NAME, sit);
+                if (init_memphy_file(mswp[sit], memswpsz[sit],
+                                     swpfile) != 0) {
+                    fprintf(stderr, "[BOOT] cannot create swap file %s\n",
+                            swpfile);
+                    exit(1);
+                }
+            } else if (init_memphy(mswp[sit], memswpsz[sit],
+                                   swapkind == SWAP_SEQ ? 0 : rdmflag) != 0) {
+                fprintf(stderr, "[BOOT] cannot create MEMSWP[%d] of size %#x, "
+                        "it must hold at least one page\n",
+                        sit, memswpsz[sit]);
+                exit(1);
+            }
+            printf("[BOOT] init MEMSWP[%d] size=%#x (%s)\n",
+                   sit, memswpsz[sit], swapkinds[swapkind]);
+            if (swap_on(mswp[sit], sit, swapprio[sit]) == 0)
+                printf("[BOOT] swapon MEMSWP[%d] prio=%d\n",
+                       sit, swapprio[sit]);
         } else {
             mswp[sit] = NULL;
             printf("[BOOT] MEMSWP[%d] disabled (size=0)\n", sit);
         }
     }
 
+    if (zswapsz > 0) {
+        if (zswap_init(zswapsz, mram->pagesz) != 0) {
+            fprintf(stderr, "[BOOT] cannot create a zswap pool of size %#lx\n",
+                    zswapsz);
+            exit(1);
+        }
+        printf("[BOOT] zswap pool size=%#lx\n", zswapsz);
+    }
+
+#ifdef MM_KSWAPD
+    if (kswapd_start(mram) != 0) {
+        fprintf(stderr, "[BOOT] cannot start kswapd\n");
+        exit(1);
+    }
+#endif
+
+#ifdef MM_TLB
+    /* One software TLB per simulated CPU */
+    if (tlb_init(num_cpus) != 0) {
+        fprintf(stderr, "[BOOT] cannot allocate TLBs for %d CPUs\n", num_cpus);
+        exit(1);
+    }
+#endif
+
     /* Make sure global kernel knows about MEMPHY (optional but nice) */
     os.mram           = mram;
     os.mswp           = mswp;
@@ -453,7 +656,7 @@ int main(int argc, char * argv[])
 #endif
 
     /* Init scheduler */
-    init_scheduler();
+    init_scheduler(num_cpus);
     OSLOG("main: scheduler initialized");
 
     /* Run CPU and loader */
@@ -474,6 +677,13 @@ int main(int argc, char * argv[])
         pthread_join(cpu[i], NULL);
     }
     pthread_join(ld, NULL);
+#ifdef MM_KSWAPD
+    kswapd_stop();
+#endif
+#ifdef MM_PAGING
+    for (i = 0; i < PAGING_MAX_MMSWP; i++)
+        MEMPHY_sync(os.mswp[i]);
+#endif
 
     /* Stop timer */
     stop_timer();
@@ -481,10 +691,21 @@ int main(int argc, char * argv[])
 
     OSLOG("main: all threads joined, exiting");
 
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    wl_stats_print(current_time(),
+                   (wall_end.tv_sec - wall_start.tv_sec) +
+                   (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9);
 
     /* Print paging statistics in the format expected by run_paging_tests.sh */
     paging_stats_print();
 
 
     return 0;
+
+usage:
+    printf("Usage: os [-p policy] [-z bytes] [-s kind] [path to configure file]\n");
+    printf("  -p  page replacement policy, one of: %s\n", pgrepl_names());
+    printf("  -z  zswap pool size, 0 pages out to MEMSWP only\n");
+    printf("  -s  MEMSWP device kind, one of: mem seq file\n");
+    return 1;
 }
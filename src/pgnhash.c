@@ -0,0 +1,88 @@
+/*
+ * Page number hash
+ * mm/pgnhash.c
+ */
+
+#include "pgnhash.h"
+#include <stdlib.h>
+
+#define HASH_MIN_SIZE	64	/* must be a power of two */
+
+static inline unsigned int hash_slot(unsigned int size, addr_t pgn)
+{
+	return (unsigned int)((pgn * 0x9E3779B97F4A7C15ULL) >> 32) &
+	       (size - 1);
+}
+
+static void hash_grow(struct pgn_hash *h)
+{
+	unsigned int size = h->size * 2, i;
+	struct pgn_hnode **slot = calloc(size, sizeof(*slot));
+
+	if (slot == NULL)
+		return;	/* keep going with longer chains */
+
+	for (i = 0; i < h->size; i++) {
+		struct pgn_hnode *n = h->slot[i], *next;
+
+		for (; n != NULL; n = next) {
+			unsigned int s = hash_slot(size, n->pgn);
+
+			next = n->next;
+			n->next = slot[s];
+			slot[s] = n;
+		}
+	}
+	free(h->slot);
+	h->slot = slot;
+	h->size = size;
+}
+
+int pgn_hash_init(struct pgn_hash *h)
+{
+	h->slot = calloc(HASH_MIN_SIZE, sizeof(struct pgn_hnode *));
+	if (h->slot == NULL)
+		return -1;
+	h->size = HASH_MIN_SIZE;
+	h->count = 0;
+	return 0;
+}
+
+void pgn_hash_free(struct pgn_hash *h)
+{
+	free(h->slot);
+	h->slot = NULL;
+	h->size = h->count = 0;
+}
+
+void pgn_hash_add(struct pgn_hash *h, struct pgn_hnode *n)
+{
+	unsigned int s;
+
+	if (h->count >= h->size)
+		hash_grow(h);
+
+	s = hash_slot(h->size, n->pgn);
+	n->next = h->slot[s];
+	h->slot[s] = n;
+	h->count++;
+}
+
+struct pgn_hnode *pgn_hash_find(struct pgn_hash *h, addr_t pgn)
+{
+	struct pgn_hnode *n = h->slot[hash_slot(h->size, pgn)];
+
+	while (n != NULL && n->pgn != pgn)
+		n = n->next;
+	return n;
+}
+
+void pgn_hash_del(struct pgn_hash *h, struct pgn_hnode *n)
+{
+	struct pgn_hnode **pp = &h->slot[hash_slot(h->size, n->pgn)];
+
+	while (*pp != n)
+		pp = &(*pp)->next;
+	*pp = n->next;
+	h->count--;
+}
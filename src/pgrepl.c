@@ -0,0 +1,430 @@
+/*
+ * Page replacement policies
+ * mm/pgrepl.c
+ */
+
+#include "pgrepl.h"
+#include "pgnhash.h"
+#include "mm.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Lists of a replacement state. Each policy gives them its own
+ * meaning; resident pages live on the first two, ghosts (pages
+ * already evicted, remembered by page number only) on the last two.
+ *
+ *           RES_A    RES_B    GHOST_A  GHOST_B
+ *   fifo    queue
+ *   clock   clock
+ *   2q      A1in     Am       A1out
+ *   arc     T1       T2       B1       B2
+ */
+enum {
+	RES_A,
+	RES_B,
+	GHOST_A,
+	GHOST_B,
+	NUM_LISTS
+};
+
+struct pg_node {
+	struct pgn_hnode h;		/* keyed by page number, first */
+	int list;
+	struct pg_node *prev, *next;	/* on its list, circular */
+};
+
+struct pg_list {
+	struct pg_node head;		/* sentinel */
+	int len;
+};
+
+struct pgrepl_t {
+	struct pg_list list[NUM_LISTS];
+	/* Every node by page number, to find ghosts on a refault */
+	struct pgn_hash hash;
+	int p;				/* arc: target length of T1 */
+	int last;			/* resident list of the last victim */
+};
+
+struct pgrepl_ops {
+	const char *name;
+	int (*insert)(struct pgrepl_t *repl, addr_t pgn);
+	int (*evict)(struct pgrepl_t *repl, struct pcb_t *caller,
+		     addr_t *pgn);
+};
+
+/*
+ * Lists
+ */
+
+static inline int len(struct pgrepl_t *r, int l)
+{
+	return r->list[l].len;
+}
+
+/* Oldest node of list [l], NULL if it is empty */
+static inline struct pg_node *first(struct pgrepl_t *r, int l)
+{
+	struct pg_node *head = &r->list[l].head;
+
+	return head->next == head ? NULL : head->next;
+}
+
+static void list_push(struct pgrepl_t *r, int l, struct pg_node *n)
+{
+	struct pg_node *head = &r->list[l].head;
+
+	n->list = l;
+	n->prev = head->prev;
+	n->next = head;
+	head->prev->next = n;
+	head->prev = n;
+	r->list[l].len++;
+}
+
+/* Put [n] back at the head of list [l], it is the next one out */
+static void list_push_head(struct pgrepl_t *r, int l, struct pg_node *n)
+{
+	struct pg_node *head = &r->list[l].head;
+
+	n->list = l;
+	n->prev = head;
+	n->next = head->next;
+	head->next->prev = n;
+	head->next = n;
+	r->list[l].len++;
+}
+
+static void list_del(struct pgrepl_t *r, struct pg_node *n)
+{
+	n->prev->next = n->next;
+	n->next->prev = n->prev;
+	r->list[n->list].len--;
+}
+
+static struct pg_node *node_find(struct pgrepl_t *r, addr_t pgn)
+{
+	return (struct pg_node *)pgn_hash_find(&r->hash, pgn);
+}
+
+/* Track page [pgn] on list [l] */
+static struct pg_node *node_new(struct pgrepl_t *r, addr_t pgn, int l)
+{
+	struct pg_node *n = malloc(sizeof(struct pg_node));
+
+	if (n == NULL)
+		return NULL;
+
+	n->h.pgn = pgn;
+	pgn_hash_add(&r->hash, &n->h);
+	list_push(r, l, n);
+	return n;
+}
+
+static void node_free(struct pgrepl_t *r, struct pg_node *n)
+{
+	list_del(r, n);
+	pgn_hash_del(&r->hash, &n->h);
+	free(n);
+}
+
+/* Move [n] to the tail of list [l] */
+static void node_move(struct pgrepl_t *r, struct pg_node *n, int l)
+{
+	list_del(r, n);
+	list_push(r, l, n);
+}
+
+/* Test and clear the accessed bit of a resident page */
+static int referenced(struct pcb_t *caller, addr_t pgn)
+{
+	return pte_set_accessed(caller, pgn, 0) > 0;
+}
+
+/* Sweep the clock on list [l] up to a page not referenced since the
+ * last pass, giving every referenced page a second chance */
+static struct pg_node *clock_sweep(struct pgrepl_t *r, int l,
+				   struct pcb_t *caller)
+{
+	struct pg_node *n;
+
+	while ((n = first(r, l)) != NULL && referenced(caller, n->h.pgn))
+		node_move(r, n, l);
+	return n;
+}
+
+/*
+ * fifo
+ */
+
+static int fifo_insert(struct pgrepl_t *r, addr_t pgn)
+{
+	return node_new(r, pgn, RES_A) == NULL ? -1 : 0;
+}
+
+static int fifo_evict(struct pgrepl_t *r, struct pcb_t *caller, addr_t *pgn)
+{
+	struct pg_node *n = first(r, RES_A);
+
+	(void)caller;
+	if (n == NULL)
+		return -1;
+	*pgn = n->h.pgn;
+	r->last = RES_A;
+	node_free(r, n);
+	return 0;
+}
+
+/*
+ * clock
+ */
+
+static int clock_evict(struct pgrepl_t *r, struct pcb_t *caller, addr_t *pgn)
+{
+	struct pg_node *n = clock_sweep(r, RES_A, caller);
+
+	if (n == NULL)
+		return -1;
+	*pgn = n->h.pgn;
+	r->last = RES_A;
+	node_free(r, n);
+	return 0;
+}
+
+/*
+ * 2q: Kin and Kout are a quarter and half of the resident pages
+ */
+
+static int twoq_insert(struct pgrepl_t *r, addr_t pgn)
+{
+	struct pg_node *n = node_find(r, pgn);
+
+	if (n != NULL) {
+		/* Faulted again after leaving A1in: it is hot */
+		if (n->list == GHOST_A)
+			node_move(r, n, RES_B);
+		return 0;
+	}
+	return node_new(r, pgn, RES_A) == NULL ? -1 : 0;
+}
+
+static int twoq_evict(struct pgrepl_t *r, struct pcb_t *caller, addr_t *pgn)
+{
+	int resident = len(r, RES_A) + len(r, RES_B);
+	int kin = resident / 4 > 0 ? resident / 4 : 1;
+	int kout = resident / 2 > 0 ? resident / 2 : 1;
+	struct pg_node *n;
+
+	if (len(r, RES_A) > 0 && (len(r, RES_A) > kin || len(r, RES_B) == 0)) {
+		n = first(r, RES_A);
+		*pgn = n->h.pgn;
+		r->last = RES_A;
+		node_move(r, n, GHOST_A);
+		while (len(r, GHOST_A) > kout)
+			node_free(r, first(r, GHOST_A));
+		return 0;
+	}
+
+	n = clock_sweep(r, RES_B, caller);
+	if (n == NULL)
+		return -1;
+	*pgn = n->h.pgn;
+	r->last = RES_B;
+	node_free(r, n);
+	return 0;
+}
+
+/*
+ * arc (CAR): T1 holds pages seen once, T2 pages referenced again
+ * while resident or refaulted from a ghost list. [p] grows on B1
+ * hits and shrinks on B2 hits.
+ */
+
+/* Keep the ghosts within the number of resident pages */
+static void arc_trim(struct pgrepl_t *r)
+{
+	int c = len(r, RES_A) + len(r, RES_B);
+
+	while (len(r, GHOST_A) + len(r, GHOST_B) > c) {
+		if (len(r, GHOST_A) > 0 &&
+		    (len(r, RES_A) + len(r, GHOST_A) > c || len(r, GHOST_B) == 0))
+			node_free(r, first(r, GHOST_A));
+		else
+			node_free(r, first(r, GHOST_B));
+	}
+}
+
+static int arc_insert(struct pgrepl_t *r, addr_t pgn)
+{
+	int c = len(r, RES_A) + len(r, RES_B);
+	struct pg_node *n = node_find(r, pgn);
+	int b1, b2;
+
+	if (c == 0)
+		c = 1;
+
+	if (n == NULL)
+		return node_new(r, pgn, RES_A) == NULL ? -1 : 0;
+
+	b1 = len(r, GHOST_A);
+	b2 = len(r, GHOST_B);
+	if (n->list == GHOST_A) {
+		r->p += b2 / b1 > 1 ? b2 / b1 : 1;
+		if (r->p > c)
+			r->p = c;
+	} else if (n->list == GHOST_B) {
+		r->p -= b1 / b2 > 1 ? b1 / b2 : 1;
+		if (r->p < 0)
+			r->p = 0;
+	} else {
+		return 0;	/* already resident */
+	}
+	node_move(r, n, RES_B);
+	return 0;
+}
+
+static int arc_evict(struct pgrepl_t *r, struct pcb_t *caller, addr_t *pgn)
+{
+	struct pg_node *n;
+
+	for (;;) {
+		int t1 = len(r, RES_A), t2 = len(r, RES_B);
+
+		if (t1 + t2 == 0)
+			return -1;
+
+		if (t1 > 0 && (t1 >= (r->p > 1 ? r->p : 1) || t2 == 0)) {
+			n = first(r, RES_A);
+			if (referenced(caller, n->h.pgn)) {
+				node_move(r, n, RES_B);
+				continue;
+			}
+			*pgn = n->h.pgn;
+			r->last = RES_A;
+			node_move(r, n, GHOST_A);
+			break;
+		}
+
+		n = first(r, RES_B);
+		if (referenced(caller, n->h.pgn)) {
+			node_move(r, n, RES_B);
+			continue;
+		}
+		*pgn = n->h.pgn;
+		r->last = RES_B;
+		node_move(r, n, GHOST_B);
+		break;
+	}
+
+	arc_trim(r);
+	return 0;
+}
+
+static const struct pgrepl_ops policies[] = {
+	{ "fifo",  fifo_insert,  fifo_evict },
+	{ "clock", fifo_insert,  clock_evict },
+	{ "2q",    twoq_insert,  twoq_evict },
+	{ "arc",   arc_insert,   arc_evict },
+};
+
+#define NUM_POLICIES (int)(sizeof(policies) / sizeof(policies[0]))
+
+static const struct pgrepl_ops *policy = NULL;
+
+int pgrepl_select(const char *name)
+{
+	int i;
+
+	for (i = 0; i < NUM_POLICIES; i++) {
+		if (!strcmp(name, policies[i].name)) {
+			policy = &policies[i];
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static const struct pgrepl_ops *pgrepl_ops(void)
+{
+	if (policy == NULL && pgrepl_select(PG_REPL_POLICY) != 0)
+		policy = &policies[0];
+	return policy;
+}
+
+const char *pgrepl_name(void)
+{
+	return pgrepl_ops()->name;
+}
+
+const char *pgrepl_names(void)
+{
+	return "fifo clock 2q arc";
+}
+
+struct pgrepl_t *pgrepl_create(void)
+{
+	struct pgrepl_t *r = calloc(1, sizeof(struct pgrepl_t));
+	int l;
+
+	if (r == NULL)
+		return NULL;
+
+	if (pgn_hash_init(&r->hash) != 0) {
+		free(r);
+		return NULL;
+	}
+
+	for (l = 0; l < NUM_LISTS; l++) {
+		struct pg_node *head = &r->list[l].head;
+
+		head->prev = head->next = head;
+	}
+	return r;
+}
+
+void pgrepl_destroy(struct pgrepl_t *r)
+{
+	int l;
+
+	if (r == NULL)
+		return;
+
+	for (l = 0; l < NUM_LISTS; l++) {
+		struct pg_node *n;
+
+		while ((n = first(r, l)) != NULL)
+			node_free(r, n);
+	}
+	pgn_hash_free(&r->hash);
+	free(r);
+}
+
+int pgrepl_insert(struct pgrepl_t *r, addr_t pgn)
+{
+	return pgrepl_ops()->insert(r, pgn);
+}
+
+int pgrepl_evict(struct pgrepl_t *r, struct pcb_t *caller, addr_t *pgn)
+{
+	return pgrepl_ops()->evict(r, caller, pgn);
+}
+
+/* Not a refault: leave the ghost hit logic of the policy out of it */
+int pgrepl_reinsert(struct pgrepl_t *r, addr_t pgn)
+{
+	struct pg_node *n = node_find(r, pgn);
+
+	if (n == NULL) {
+		n = node_new(r, pgn, r->last);
+		if (n == NULL)
+			return -1;
+		list_del(r, n);
+	} else if (n->list == GHOST_A || n->list == GHOST_B) {
+		list_del(r, n);
+	} else {
+		return 0;	/* still resident */
+	}
+	list_push_head(r, r->last, n);
+	return 0;
+}
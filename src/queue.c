@@ -9,66 +9,59 @@ int empty(struct queue_t *q)
         return (q->size == 0);
 }
 
+/* Double the ring capacity, unwrapping the entries to start at 0 */
+static int queue_grow(struct queue_t *q)
+{
+        int newcap = q->cap ? q->cap * 2 : MAX_QUEUE_SIZE;
+        struct pcb_t **buf = malloc(sizeof(struct pcb_t *) * newcap);
+
+        if (buf == NULL)
+                return -1;
+
+        for (int i = 0; i < q->size; i++)
+                buf[i] = q->proc[(q->head + i) % q->cap];
+
+        free(q->proc);
+        q->proc = buf;
+        q->head = 0;
+        q->cap = newcap;
+        return 0;
+}
+
 void enqueue(struct queue_t *q, struct pcb_t *proc)
 {
-        /* TODO: put a new process to queue [q] */
         if (q == NULL || proc == NULL)
                 return;
 
-        if (q->size >= MAX_QUEUE_SIZE)
-                return;
-        
-        q->proc[q->size] = proc;
+        if (q->size == q->cap && queue_grow(q) != 0) {
+                perror("enqueue: cannot grow queue");
+                exit(1);
+        }
+
+        q->proc[(q->head + q->size) % q->cap] = proc;
         q->size++;
 }
 
 struct pcb_t *dequeue(struct queue_t *q)
 {
-        /* TODO: return a pcb whose prioprity is the highest
-         * in the queue [q] and remember to remove it from q
-         * */
         if (empty(q))
                 return NULL;
-        
-        int best = 0;           // index của phần tử có highest priority(lowest priority value)
-        
-        for (int i = 1; i < q->size; i++)
-        {
-                struct pcb_t *cur = q->proc[i];
-                struct pcb_t *best_proc = q->proc[best];
-
-                /* Lấy priority hoặc prior tương ứng:
-                - Nếu có MLQ_SCHED: dùng prio
-                - Nếu không: dùng priority
-                */
 
-#ifdef MLQ_SCHED
-                uint32_t cur_prio = cur->prio;
-                uint32_t best_prio = best_proc->prio;
-#else   
-                uint32_t cur_prio = cur->priority;
-                uint32_t best_prio = best_proc->priority;
-#endif
+        struct pcb_t *ret = q->proc[q->head];
 
-                // the lower value -> the higher priority
-                if (cur_prio < best_prio)
-                        best = i;
-                
-        }
+        q->head = (q->head + 1) % q->cap;
+        q->size--;
 
-        // Save pcb
-        struct pcb_t *ret = q->proc[best];
+	return ret;
+}
 
-        // Dồn phần tử
-        for (int i = best; i < q->size - 1; i++)
-        {
-                q->proc[i] = q->proc[i + 1];
-        }
+struct pcb_t *dequeue_tail(struct queue_t *q)
+{
+        if (empty(q))
+                return NULL;
 
-        // Giảm sau khi lấy ra
         q->size--;
-
-	return ret;
+        return q->proc[(q->head + q->size) % q->cap];
 }
 
 struct pcb_t *purgequeue(struct queue_t *q, struct pcb_t *proc)
@@ -81,17 +74,156 @@ struct pcb_t *purgequeue(struct queue_t *q, struct pcb_t *proc)
         // finding the pcb
         for (int i = 0; i < q->size; i++)
         {
-                if (q->proc[i] == proc)         // PCB cần tìm
+                if (q->proc[(q->head + i) % q->cap] == proc)         // PCB cần tìm
                 {
-                        struct pcb_t *ret = q->proc[i];
+                        // close the gap by shifting the newer entries down
                         for (int j = i; j < q->size - 1; j++ )
                         {
-                                q->proc[j] = q->proc[j + 1];
+                                q->proc[(q->head + j) % q->cap] =
+                                        q->proc[(q->head + j + 1) % q->cap];
                         }
                         q->size--;
-                        return ret;
+                        return proc;
                 }
         }
 
         return NULL;       
-}
\ No newline at end of file
+}
+
+/* ------------------------------------------------------------------ */
+/* Intrusive process list                                              */
+/* ------------------------------------------------------------------ */
+
+int plist_empty(struct proc_list_t *l)
+{
+        if (l == NULL)
+                return 1;
+        return (l->size == 0);
+}
+
+void plist_add_tail(struct proc_list_t *l, struct pcb_t *proc)
+{
+        if (l == NULL || proc == NULL)
+                return;
+
+        /* a PCB lives on one list at a time, move it if needed */
+        if (proc->q_list != NULL)
+                plist_remove(proc->q_list, proc);
+
+        proc->q_prev = l->tail;
+        proc->q_next = NULL;
+        if (l->tail != NULL)
+                l->tail->q_next = proc;
+        else
+                l->head = proc;
+        l->tail = proc;
+        proc->q_list = l;
+        l->size++;
+}
+
+struct pcb_t *plist_remove(struct proc_list_t *l, struct pcb_t *proc)
+{
+        if (l == NULL || proc == NULL || proc->q_list != l)
+                return NULL;
+
+        if (proc->q_prev != NULL)
+                proc->q_prev->q_next = proc->q_next;
+        else
+                l->head = proc->q_next;
+        if (proc->q_next != NULL)
+                proc->q_next->q_prev = proc->q_prev;
+        else
+                l->tail = proc->q_prev;
+
+        proc->q_prev = proc->q_next = NULL;
+        proc->q_list = NULL;
+        l->size--;
+        return proc;
+}
+
+/* ------------------------------------------------------------------ */
+/* Heap-backed priority queue                                          */
+/* ------------------------------------------------------------------ */
+
+static inline uint32_t pq_key(struct pcb_t *proc)
+{
+#ifdef MLQ_SCHED
+        return proc->prio;
+#else
+        return proc->priority;
+#endif
+}
+
+/* [a] leaves before [b]: higher priority first, then FIFO */
+static inline int pq_before(struct pq_node_t *a, struct pq_node_t *b)
+{
+        if (a->prio != b->prio)
+                return a->prio < b->prio;
+        return a->seq < b->seq;
+}
+
+int pq_empty(struct prio_queue_t *q)
+{
+        if (q == NULL)
+                return 1;
+        return (q->size == 0);
+}
+
+void pq_enqueue(struct prio_queue_t *q, struct pcb_t *proc)
+{
+        if (q == NULL || proc == NULL)
+                return;
+
+        if (q->size == q->cap) {
+                int newcap = q->cap ? q->cap * 2 : MAX_QUEUE_SIZE;
+                struct pq_node_t *heap =
+                        realloc(q->heap, sizeof(struct pq_node_t) * newcap);
+                if (heap == NULL) {
+                        perror("pq_enqueue: cannot grow queue");
+                        exit(1);
+                }
+                q->heap = heap;
+                q->cap = newcap;
+        }
+
+        struct pq_node_t node = { proc, pq_key(proc), q->seq++ };
+        int i = q->size++;
+
+        /* sift up */
+        while (i > 0) {
+                int parent = (i - 1) / 2;
+                if (!pq_before(&node, &q->heap[parent]))
+                        break;
+                q->heap[i] = q->heap[parent];
+                i = parent;
+        }
+        q->heap[i] = node;
+}
+
+struct pcb_t *pq_dequeue(struct prio_queue_t *q)
+{
+        if (pq_empty(q))
+                return NULL;
+
+        struct pcb_t *ret = q->heap[0].proc;
+        struct pq_node_t last = q->heap[--q->size];
+        int i = 0;
+
+        /* sift the last node down from the root */
+        while (1) {
+                int child = 2 * i + 1;
+                if (child >= q->size)
+                        break;
+                if (child + 1 < q->size &&
+                    pq_before(&q->heap[child + 1], &q->heap[child]))
+                        child++;
+                if (!pq_before(&q->heap[child], &last))
+                        break;
+                q->heap[i] = q->heap[child];
+                i = child;
+        }
+        if (q->size > 0)
+                q->heap[i] = last;
+
+        return ret;
+}
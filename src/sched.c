@@ -10,167 +10,330 @@
 
 #include "queue.h"
 #include "sched.h"
+#include "bitops.h"
+#include "cpu.h"
 #include <pthread.h>
 
 #include <stdlib.h>
 #include <stdio.h>
-static struct queue_t ready_queue;
-static struct queue_t run_queue;
+static struct prio_queue_t ready_queue;
+static struct prio_queue_t run_queue;
 static pthread_mutex_t queue_lock;
 
-static struct queue_t running_list;
+#ifndef MLQ_SCHED
+static struct proc_list_t running_list;
+#endif
 #ifdef MLQ_SCHED
-static struct queue_t mlq_ready_queue[MAX_PRIO];
-static int slot[MAX_PRIO];
-static int mlq_inited = 0;			// biến trạng thái cho MLQ
+/*
+ * Priority bitmaps, one bit per MLQ level:
+ *   prio_ready_map - mlq_ready_queue[prio] is not empty
+ *   prio_slot_map  - prio still has slot budget in the current round
+ * Slot budgets are refilled lazily: a level whose slot_epoch is behind
+ * cur_epoch gets MAX_PRIO - prio slots the next time it is picked, so
+ * starting a new round is O(1) as well.
+ */
+#define PRIO_MAP_WORDS BITS_TO_LONGS(MAX_PRIO)
+#define PRIO_MAP_BITS  (sizeof(unsigned long) * 8)
+
+/*
+ * Per-CPU MLQ run queue. Every simulated CPU dispatches from its own
+ * run queue under its own lock; an idle CPU steals from the tail of
+ * the busiest peer. Locks of two run queues are never held together.
+ */
+struct mlq_rq_t {
+	pthread_mutex_t lock;
+	struct queue_t mlq_ready_queue[MAX_PRIO];
+	struct proc_list_t running_list;
+	int slot[MAX_PRIO];
+	unsigned long prio_ready_map[PRIO_MAP_WORDS];
+	unsigned long prio_slot_map[PRIO_MAP_WORDS];
+	unsigned int slot_epoch[MAX_PRIO];
+	unsigned int cur_epoch;
+	int nr_ready;		/* queued processes, read locklessly for balancing */
+	int nr_running;		/* dispatched processes */
+};
+
+static struct mlq_rq_t *mlq_rqs;
+static int num_rqs;
+
+static inline void prio_map_set(unsigned long *map, int prio)
+{
+	map[prio / PRIO_MAP_BITS] |= 1UL << (prio % PRIO_MAP_BITS);
+}
+
+static inline void prio_map_clear(unsigned long *map, int prio)
+{
+	map[prio / PRIO_MAP_BITS] &= ~(1UL << (prio % PRIO_MAP_BITS));
+}
+
+/* Mark every level as having budget for a fresh round */
+static inline void prio_slot_map_fill(unsigned long *map)
+{
+	int w;
+
+	for (w = 0; w < (int)PRIO_MAP_WORDS; w++)
+		map[w] = ~0UL;
+	if (MAX_PRIO % PRIO_MAP_BITS)
+		map[PRIO_MAP_WORDS - 1] = ~0UL >> (PRIO_MAP_BITS - MAX_PRIO % PRIO_MAP_BITS);
+}
+
+/* Lowest prio set in both maps ([b] may be NULL), -1 if none */
+static inline int prio_map_first(const unsigned long *a, const unsigned long *b)
+{
+	int w;
+
+	for (w = 0; w < (int)PRIO_MAP_WORDS; w++) {
+		unsigned long word = b ? (a[w] & b[w]) : a[w];
+		if (word)
+			return w * PRIO_MAP_BITS + __builtin_ctzl(word);
+	}
+	return -1;
+}
+
+/* Run queue of the calling CPU; non-CPU threads fall back to CPU 0 */
+static inline struct mlq_rq_t *this_rq(void)
+{
+	int cpu = cpu_current();
+
+	if (cpu < 0 || cpu >= num_rqs)
+		cpu = 0;
+	return &mlq_rqs[cpu];
+}
+
+static inline int rq_load(struct mlq_rq_t *rq)
+{
+	return __atomic_load_n(&rq->nr_ready, __ATOMIC_RELAXED) +
+	       __atomic_load_n(&rq->nr_running, __ATOMIC_RELAXED);
+}
+
+static inline void rq_set_krnl(struct mlq_rq_t *rq, struct pcb_t *proc)
+{
+	proc->krnl->ready_queue     = &ready_queue;
+	proc->krnl->mlq_ready_queue = rq->mlq_ready_queue;
+	proc->krnl->running_list    = &rq->running_list;
+}
 #endif
 
 int queue_empty(void) {
 #ifdef MLQ_SCHED
-	unsigned long prio;
-	for (prio = 0; prio < MAX_PRIO; prio++)
-	{
-		if(!empty(&mlq_ready_queue[prio])) 
-			return 0;					// Not empty						
-	}
-	return 1;							// all MLQ rỗng
+	int cpu;
+
+	for (cpu = 0; cpu < num_rqs; cpu++)
+		if (__atomic_load_n(&mlq_rqs[cpu].nr_ready, __ATOMIC_RELAXED) > 0)
+			return 0;
+	return 1;
 #endif
-	return (empty(&ready_queue) && empty(&run_queue));
+	return (pq_empty(&ready_queue) && pq_empty(&run_queue));
 }
 
-void init_scheduler(void) {
+void init_scheduler(int num_cpus) {
 #ifdef MLQ_SCHED
-    int i ;
+	int cpu, i;
 
-	for (i = 0; i < MAX_PRIO; i ++) {
-		mlq_ready_queue[i].size = 0;
-		slot[i] = MAX_PRIO - i; 
+	if (num_cpus < 1)
+		num_cpus = 1;
+
+	mlq_rqs = calloc(num_cpus, sizeof(struct mlq_rq_t));
+	if (mlq_rqs == NULL) {
+		perror("calloc mlq_rqs");
+		exit(1);
+	}
+	num_rqs = num_cpus;
+
+	for (cpu = 0; cpu < num_rqs; cpu++) {
+		struct mlq_rq_t *rq = &mlq_rqs[cpu];
+
+		pthread_mutex_init(&rq->lock, NULL);
+		for (i = 0; i < MAX_PRIO; i ++)
+			rq->mlq_ready_queue[i].size = 0;
+		rq->cur_epoch = 1;		// every level refills on first pick
+		prio_slot_map_fill(rq->prio_slot_map);
 	}
-	mlq_inited = 1;			// cập nhật trạng thái 
+#else
+	(void)num_cpus;
 #endif
 	ready_queue.size 	= 0;
 	run_queue.size 		= 0;
-	running_list.size 	= 0;
 	pthread_mutex_init(&queue_lock, NULL);
 }
 
 #ifdef MLQ_SCHED
-/* 
- *  Stateful design for routine calling
- *  based on the priority and our MLQ policy
- *  We implement stateful here using transition technique
- *  State representation   prio = 0 .. MAX_PRIO, curr_slot = 0..(MAX_PRIO - prio)
- */
-struct pcb_t * get_mlq_proc(void) {
-	struct pcb_t * proc = NULL;
-	int p;
+/* Enqueue on an MLQ level and mark it non-empty, rq->lock held */
+static void mlq_enqueue(struct mlq_rq_t *rq, struct pcb_t *proc)
+{
+	enqueue(&rq->mlq_ready_queue[proc->prio], proc);
+	prio_map_set(rq->prio_ready_map, proc->prio);
+	__atomic_store_n(&rq->nr_ready, rq->nr_ready + 1, __ATOMIC_RELAXED);
+}
+
+/* Take the next process by MLQ policy from [rq], rq->lock held */
+static struct pcb_t *mlq_pick(struct mlq_rq_t *rq)
+{
+	struct pcb_t *proc;
 	int chosen_prio;
 
-	pthread_mutex_lock(&queue_lock);
-	/*TODO: get a process from PRIORITY [ready_queue].
-	 *      It worth to protect by a mechanism.
-	 * */
+	// highest priority level that is non-empty and still has slots
+	chosen_prio = prio_map_first(rq->prio_ready_map, rq->prio_slot_map);
 
-	// đảm bảo slot[] được khởi tạo
-	if (!mlq_inited)
+	if (chosen_prio < 0)
 	{
-		for (int i = 0; i < MAX_PRIO; i++)
-			slot[i] = MAX_PRIO - i;
-		mlq_inited = 1;
+		// nothing ready at all -> no proc
+		if (prio_map_first(rq->prio_ready_map, NULL) < 0)
+			return NULL;
+
+		// every ready level used up its slots -> start a new round
+		rq->cur_epoch++;
+		prio_slot_map_fill(rq->prio_slot_map);
+		chosen_prio = prio_map_first(rq->prio_ready_map, NULL);
 	}
 
-	// nếu tất cả queue đều rỗng -> không còn proc
-	if (queue_empty())
+	if (rq->slot_epoch[chosen_prio] != rq->cur_epoch)
 	{
-		pthread_mutex_unlock(&queue_lock);
-		return NULL;
+		rq->slot[chosen_prio] = MAX_PRIO - chosen_prio;
+		rq->slot_epoch[chosen_prio] = rq->cur_epoch;
 	}
 
-	// chọn priority có slot > 0 && queue ko rỗng
-	chosen_prio = -1;
-	for (p = 0; p < MAX_PRIO; p++)
+	proc = dequeue(&rq->mlq_ready_queue[chosen_prio]);
+	if (empty(&rq->mlq_ready_queue[chosen_prio]))
+		prio_map_clear(rq->prio_ready_map, chosen_prio);
+
+	if (proc != NULL)
 	{
-		if (!empty(&mlq_ready_queue[p]) && slot[p] > 0)
-		{
-			chosen_prio = p;
-			break;
-		}
+		if (--rq->slot[chosen_prio] == 0)
+			prio_map_clear(rq->prio_slot_map, chosen_prio);
+		__atomic_store_n(&rq->nr_ready, rq->nr_ready - 1, __ATOMIC_RELAXED);
 	}
 
-	// đã thấy mlq cần tìm nhưng hết slot -> reset slot[]
-	if (chosen_prio < 0)
-	{
-		for (p = 0; p < MAX_PRIO; p++)
-			slot[p] = MAX_PRIO - p;		// reset to get proc
-
-		// tìm lại 
-		for (p = 0; p < MAX_PRIO; p++)
-		{
-			if (!empty(&mlq_ready_queue[p]) && slot[p] > 0)	
-			{
-				chosen_prio = p;
-				break;
-			}
+	return proc;
+}
+
+/* Steal the most recently queued process of the highest non-empty
+ * level of [rq], rq->lock held. Stealing from the tail leaves the
+ * owner's FIFO order intact. */
+static struct pcb_t *mlq_steal(struct mlq_rq_t *rq)
+{
+	struct pcb_t *proc;
+	int prio = prio_map_first(rq->prio_ready_map, NULL);
+
+	if (prio < 0)
+		return NULL;
+
+	proc = dequeue_tail(&rq->mlq_ready_queue[prio]);
+	if (empty(&rq->mlq_ready_queue[prio]))
+		prio_map_clear(rq->prio_ready_map, prio);
+	if (proc != NULL)
+		__atomic_store_n(&rq->nr_ready, rq->nr_ready - 1, __ATOMIC_RELAXED);
+
+	return proc;
+}
+
+/* Move one process from the busiest peer of [self] */
+static struct pcb_t *mlq_steal_from_busiest(struct mlq_rq_t *self)
+{
+	struct pcb_t *proc = NULL;
+	struct mlq_rq_t *victim = NULL;
+	int best = 0;
+	int cpu;
+
+	for (cpu = 0; cpu < num_rqs; cpu++) {
+		struct mlq_rq_t *rq = &mlq_rqs[cpu];
+		int nr = __atomic_load_n(&rq->nr_ready, __ATOMIC_RELAXED);
+
+		if (rq != self && nr > best) {
+			best = nr;
+			victim = rq;
 		}
 	}
 
-	// đã tìm thấy -> lấy ra khỏi ready -> thêm vào running
-	if (chosen_prio >= 0)
+	if (victim == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&victim->lock);
+	proc = mlq_steal(victim);
+	pthread_mutex_unlock(&victim->lock);
+
+	return proc;
+}
+
+/* 
+ *  Stateful design for routine calling
+ *  based on the priority and our MLQ policy
+ *  We implement stateful here using transition technique
+ *  State representation   prio = 0 .. MAX_PRIO, curr_slot = 0..(MAX_PRIO - prio)
+ */
+struct pcb_t * get_mlq_proc(void) {
+	struct mlq_rq_t *rq = this_rq();
+	struct pcb_t * proc = NULL;
+
+	pthread_mutex_lock(&rq->lock);
+	proc = mlq_pick(rq);
+	pthread_mutex_unlock(&rq->lock);
+
+	// local run queue is empty -> try to pull work from a peer
+	if (proc == NULL && num_rqs > 1)
+		proc = mlq_steal_from_busiest(rq);
+
+	if (proc != NULL)
 	{
-		proc = dequeue(&mlq_ready_queue[chosen_prio]);
-		if (proc != NULL)
-		{
-			slot[chosen_prio]--;
-
-			// update con trỏ kernel của proc
-			proc->krnl->ready_queue 	= &ready_queue;
-			proc->krnl->mlq_ready_queue = mlq_ready_queue;
-			proc->krnl->running_list	= &running_list;
-
-			// đưa proc vào running list
-			enqueue(&running_list, proc);
-		}
+		pthread_mutex_lock(&rq->lock);
+
+		// update con trỏ kernel của proc
+		rq_set_krnl(rq, proc);
+
+		// đưa proc vào running list
+		plist_add_tail(&rq->running_list, proc);
+		__atomic_store_n(&rq->nr_running, rq->nr_running + 1, __ATOMIC_RELAXED);
+
+		pthread_mutex_unlock(&rq->lock);
 	}
 
-	pthread_mutex_unlock(&queue_lock);
 	return proc;
 }
 
 /* Put a process back to run queue */
 void put_mlq_proc(struct pcb_t * proc) {
-	proc->krnl->ready_queue 	= &ready_queue;
-	proc->krnl->mlq_ready_queue = mlq_ready_queue;
-	proc->krnl->running_list 	= &running_list;
+	struct mlq_rq_t *rq = this_rq();
 
 	/* TODO: put running proc to running_list 
 	 *       It worth to protect by a mechanism.
 	 */
-	pthread_mutex_lock(&queue_lock);
-	
+	pthread_mutex_lock(&rq->lock);
+
+	rq_set_krnl(rq, proc);
+
 	// proc đang RUNNING -> gỡ khỏi running_list -> trả về ready_list
-	purgequeue(&running_list, proc);
-	enqueue(&mlq_ready_queue[proc->prio], proc);
+	if (plist_remove(&rq->running_list, proc) != NULL)
+		__atomic_store_n(&rq->nr_running, rq->nr_running - 1, __ATOMIC_RELAXED);
+	mlq_enqueue(rq, proc);
 
-	pthread_mutex_unlock(&queue_lock);
+	pthread_mutex_unlock(&rq->lock);
 }
 
-/* Add a new process to ready queue */
+/* Add a new process to the ready queue of the least loaded CPU */
 void add_mlq_proc(struct pcb_t * proc) {
-	proc->krnl->ready_queue 	= &ready_queue;
-	proc->krnl->mlq_ready_queue = mlq_ready_queue;
-	proc->krnl->running_list 	= &running_list;
+	struct mlq_rq_t *rq = &mlq_rqs[0];
+	int cpu;
 
-	/* TODO: put running proc to running_list
-	 *       It worth to protect by a mechanism.
-	 * 
-	 */
-       
-	pthread_mutex_lock(&queue_lock);
+	for (cpu = 1; cpu < num_rqs; cpu++)
+		if (rq_load(&mlq_rqs[cpu]) < rq_load(rq))
+			rq = &mlq_rqs[cpu];
 
-	purgequeue(&running_list, proc);		// cho chắc thui =))
-	enqueue(&mlq_ready_queue[proc->prio], proc);
+	pthread_mutex_lock(&rq->lock);
 
-	pthread_mutex_unlock(&queue_lock);	
+	rq_set_krnl(rq, proc);
+	mlq_enqueue(rq, proc);
+
+	pthread_mutex_unlock(&rq->lock);	
+}
+
+/* A finished process leaves the running list of the CPU that ran it */
+void finish_mlq_proc(struct pcb_t * proc) {
+	struct mlq_rq_t *rq = this_rq();
+
+	pthread_mutex_lock(&rq->lock);
+	if (plist_remove(&rq->running_list, proc) != NULL)
+		__atomic_store_n(&rq->nr_running, rq->nr_running - 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&rq->lock);
 }
 
 struct pcb_t * get_proc(void) {
@@ -184,6 +347,10 @@ void put_proc(struct pcb_t * proc) {
 void add_proc(struct pcb_t * proc) {
 	return add_mlq_proc(proc);
 }
+
+void finish_proc(struct pcb_t * proc) {
+	return finish_mlq_proc(proc);
+}
 #else
 
 struct pcb_t * get_proc(void) {
@@ -195,21 +362,21 @@ struct pcb_t * get_proc(void) {
 	 */
 
 	// ưu tiên lấy từ run_queue(running -> idle -> ready)
-	if (!empty(&run_queue))
+	if (!pq_empty(&run_queue))
 	{
-		proc = dequeue(&run_queue);
+		proc = pq_dequeue(&run_queue);
 	}
 	else
 	{
 	// run_queue rỗng => chọn từ ready_queue
-		proc = dequeue(&ready_queue);
+		proc = pq_dequeue(&ready_queue);
 	}
 
 	if (proc != NULL)
 	{
 		proc->krnl->ready_queue		= &ready_queue;
 		proc->krnl->running_list	= &running_list;
-		enqueue(&running_list, proc);
+		plist_add_tail(&running_list, proc);
 	}
 	pthread_mutex_unlock(&queue_lock);
 
@@ -226,8 +393,8 @@ void put_proc(struct pcb_t * proc) {
 
 	pthread_mutex_lock(&queue_lock);
 
-	purgequeue(&running_list, proc);
-	enqueue(&run_queue, proc);
+	plist_remove(&running_list, proc);
+	pq_enqueue(&run_queue, proc);
 
 	pthread_mutex_unlock(&queue_lock);
 }
@@ -242,11 +409,17 @@ void add_proc(struct pcb_t * proc) {
 
 	pthread_mutex_lock(&queue_lock);
 
-	purgequeue(&running_list, proc);
-	enqueue(&ready_queue, proc);
+	plist_remove(&running_list, proc);
+	pq_enqueue(&ready_queue, proc);
 
 	pthread_mutex_unlock(&queue_lock);	
 }
+
+void finish_proc(struct pcb_t * proc) {
+	pthread_mutex_lock(&queue_lock);
+	plist_remove(&running_list, proc);
+	pthread_mutex_unlock(&queue_lock);
+}
 #endif
 
 
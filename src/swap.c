@@ -0,0 +1,93 @@
+/*
+ * Swap devices
+ * mm/swap.c
+ */
+
+#include "swap.h"
+#include "mm.h"
+#include <pthread.h>
+
+struct swap_info {
+	struct memphy_struct *dev;
+	int swptyp;
+	int prio;
+	int rr;			/* first of a priority: next device to use */
+};
+
+/* By priority, highest first */
+static struct swap_info swp[PAGING_MAX_MMSWP];
+static int nr_swp;
+static pthread_mutex_t swap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int swap_on(struct memphy_struct *dev, int swptyp, int prio)
+{
+	int i, j;
+
+	if (dev == NULL || swptyp < 0 || swptyp >= PAGING_MAX_MMSWP)
+		return -1;
+
+	pthread_mutex_lock(&swap_lock);
+	if (nr_swp == PAGING_MAX_MMSWP) {
+		pthread_mutex_unlock(&swap_lock);
+		return -1;
+	}
+
+	/* Behind the devices of the same priority */
+	for (i = 0; i < nr_swp && swp[i].prio >= prio; i++)
+		;
+	for (j = nr_swp; j > i; j--)
+		swp[j] = swp[j - 1];
+	swp[i].dev = dev;
+	swp[i].swptyp = swptyp;
+	swp[i].prio = prio;
+	swp[i].rr = 0;
+	nr_swp++;
+	pthread_mutex_unlock(&swap_lock);
+	return 0;
+}
+
+int swap_get_slots(int n, int *swptyp, addr_t *slot)
+{
+	int first, last, k;
+
+	pthread_mutex_lock(&swap_lock);
+	for (first = 0; first < nr_swp; first = last) {
+		int nr;
+
+		for (last = first + 1;
+		     last < nr_swp && swp[last].prio == swp[first].prio; last++)
+			;
+		nr = last - first;
+
+		/* Round robin from the device after the last one used */
+		for (k = 0; k < nr; k++) {
+			int i = first + (swp[first].rr + k) % nr;
+			int got = MEMPHY_get_cluster(swp[i].dev, n, slot);
+
+			if (got > 0) {
+				swp[first].rr = (i - first + 1) % nr;
+				*swptyp = swp[i].swptyp;
+				pthread_mutex_unlock(&swap_lock);
+				return got;
+			}
+		}
+	}
+	pthread_mutex_unlock(&swap_lock);
+	return 0;
+}
+
+struct memphy_struct *swap_device(int swptyp)
+{
+	struct memphy_struct *dev = NULL;
+	int i;
+
+	pthread_mutex_lock(&swap_lock);
+	for (i = 0; i < nr_swp; i++) {
+		if (swp[i].swptyp == swptyp) {
+			dev = swp[i].dev;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&swap_lock);
+	return dev;
+}
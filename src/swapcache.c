@@ -0,0 +1,86 @@
+/*
+ * Swap cache
+ * mm/swapcache.c
+ */
+
+#include "swapcache.h"
+#include "pgnhash.h"
+#include "mm.h"
+#include <stdlib.h>
+
+struct sc_entry {
+	struct pgn_hnode h;		/* keyed by page number, first */
+	addr_t swpoff;
+	int swptyp;
+};
+
+struct swapcache_t {
+	struct pgn_hash hash;
+};
+
+struct swapcache_t *swapcache_create(void)
+{
+	struct swapcache_t *sc = malloc(sizeof(struct swapcache_t));
+
+	if (sc == NULL)
+		return NULL;
+
+	if (pgn_hash_init(&sc->hash) != 0) {
+		free(sc);
+		return NULL;
+	}
+	return sc;
+}
+
+void swapcache_destroy(struct swapcache_t *sc, struct memphy_struct **mswp)
+{
+	unsigned int i;
+
+	if (sc == NULL)
+		return;
+
+	for (i = 0; i < sc->hash.size; i++) {
+		struct pgn_hnode *n = sc->hash.slot[i], *next;
+
+		for (; n != NULL; n = next) {
+			struct sc_entry *e = (struct sc_entry *)n;
+
+			next = n->next;
+			if (mswp != NULL && mswp[e->swptyp] != NULL)
+				MEMPHY_put_freefp(mswp[e->swptyp], e->swpoff);
+			free(e);
+		}
+	}
+	pgn_hash_free(&sc->hash);
+	free(sc);
+}
+
+int swapcache_add(struct swapcache_t *sc, addr_t pgn,
+		  int swptyp, addr_t swpoff)
+{
+	struct sc_entry *e = malloc(sizeof(struct sc_entry));
+
+	if (e == NULL)
+		return -1;
+
+	e->h.pgn = pgn;
+	e->swptyp = swptyp;
+	e->swpoff = swpoff;
+	pgn_hash_add(&sc->hash, &e->h);
+	return 0;
+}
+
+int swapcache_take(struct swapcache_t *sc, addr_t pgn,
+		   int *swptyp, addr_t *swpoff)
+{
+	struct sc_entry *e = (struct sc_entry *)pgn_hash_find(&sc->hash, pgn);
+
+	if (e == NULL)
+		return -1;
+
+	*swptyp = e->swptyp;
+	*swpoff = e->swpoff;
+	pgn_hash_del(&sc->hash, &e->h);
+	free(e);
+	return 0;
+}
@@ -13,6 +13,7 @@
 #include "libmem.h"
 #include "queue.h"
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef MM64
 #include "mm64.h"
@@ -27,10 +28,15 @@ int __sys_memmap(struct krnl_t *krnl, uint32_t pid, struct sc_regs* regs)
    int memop = regs->a1;
    BYTE value;
    
-   /* TODO THIS DUMMY CREATE EMPTY PROC TO AVOID COMPILER NOTIFY 
-    *      need to be eliminated
-	*/
-   struct pcb_t *caller = malloc(sizeof(struct pcb_t));
+   /* Kernel-side view of the calling process: only the identity and the
+    * kernel it runs on are visible here, never the user PCB itself.
+    */
+   struct pcb_t kcaller;
+   struct pcb_t *caller = &kcaller;
+
+   memset(caller, 0, sizeof(struct pcb_t));
+   caller->pid  = pid;
+   caller->krnl = krnl;
 
    /*
     * @bksysnet: Please note in the dual spacing design
@@ -55,7 +61,7 @@ int __sys_memmap(struct krnl_t *krnl, uint32_t pid, struct sc_regs* regs)
             inc_vma_limit(caller, regs->a2, regs->a3);
             break;
    case SYSMEM_SWP_OP:
-            __mm_swap_page(caller, regs->a2, regs->a3);
+            __mm_swap_page(caller, regs->a2, regs->a3, regs->a4);
             break;
    case SYSMEM_IO_READ:
             MEMPHY_read(caller->krnl->mram, regs->a2, &value);
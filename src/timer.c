@@ -1,9 +1,13 @@
 
 #include "timer.h"
+#include "os-cfg.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
-static pthread_t _timer;
+#ifndef TIMER_SPIN_COUNT
+#define TIMER_SPIN_COUNT 1000
+#endif
 
 struct timer_id_container_t {
 	struct timer_id_t id;
@@ -15,81 +19,148 @@ static struct timer_id_container_t * dev_list = NULL;
 static uint64_t _time;
 
 static int timer_started = 0;
-static int timer_stop = 0;
-
-
-static void * timer_routine(void * args) {
-	while (!timer_stop) {
-		printf("Time slot %3llu\n", current_time());
-		int fsh = 0;
-		int event = 0;
-		/* Wait for all devices have done the job in current
-		 * time slot */
-		struct timer_id_container_t * temp;
-		for (temp = dev_list; temp != NULL; temp = temp->next) {
-			pthread_mutex_lock(&temp->id.event_lock);
-			while (!temp->id.done && !temp->id.fsh) {
-				pthread_cond_wait(
-					&temp->id.event_cond,
-					&temp->id.event_lock
-				);
-			}
-			if (temp->id.fsh) {
-				fsh++;
-			}
-			event++;
-			pthread_mutex_unlock(&temp->id.event_lock);
-		}
 
-		/* Increase the time slot */
-		_time++;
-		
-		/* Let devices continue their job */
-		for (temp = dev_list; temp != NULL; temp = temp->next) {
-			pthread_mutex_lock(&temp->id.timer_lock);
-			temp->id.done = 0;
-			pthread_cond_signal(&temp->id.timer_cond);
-			pthread_mutex_unlock(&temp->id.timer_lock);
-		}
-		if (fsh == event) {
-			break;
-		}
-	}
-	pthread_exit(args);
+/*
+ * Tick barrier state
+ *   n_active  - attached devices that have not detached yet
+ *   remaining - devices still to arrive in the current slot
+ *   sense     - flipped by the last arriver to end the slot
+ *   sleepers  - devices blocked on sleep_cond
+ * The last arriver resets [remaining] before flipping [sense], and no
+ * device can arrive or detach for the next slot before that flip, so
+ * every field but [remaining] has a single writer at a time.
+ */
+static int n_active = 0;
+static int remaining = 0;
+static int sense = 0;
+static int sleepers = 0;
+static pthread_mutex_t sleep_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sleep_cond = PTHREAD_COND_INITIALIZER;
+
+/* Work done between two slots, see timer_set_slot_hook() */
+static void (*slot_hook)(void) = NULL;
+
+/* Spinning only pays off when the arriving device can run meanwhile */
+static int spin_count = TIMER_SPIN_COUNT;
+
+#ifdef TIMER_EVENT_DRIVEN
+/* Earliest wake-up asked for by a device in the current slot */
+static uint64_t slot_wake = TIMER_NEVER;
+
+static void slot_wake_min(uint64_t wake)
+{
+	uint64_t cur = __atomic_load_n(&slot_wake, __ATOMIC_RELAXED);
+
+	while (wake < cur &&
+	       !__atomic_compare_exchange_n(&slot_wake, &cur, wake, 1,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+#endif
+
+/* Block until the slot of [my_sense] ends */
+static void barrier_sleep(int my_sense)
+{
+	pthread_mutex_lock(&sleep_lock);
+	__atomic_add_fetch(&sleepers, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&sense, __ATOMIC_SEQ_CST) != my_sense)
+		pthread_cond_wait(&sleep_cond, &sleep_lock);
+	__atomic_sub_fetch(&sleepers, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&sleep_lock);
+}
+
+static void barrier_wake_all(void)
+{
+	pthread_mutex_lock(&sleep_lock);
+	pthread_cond_broadcast(&sleep_cond);
+	pthread_mutex_unlock(&sleep_lock);
+}
+
+/* End the current slot, called by whoever completes the barrier */
+static void advance_slot(void)
+{
+	int active = __atomic_load_n(&n_active, __ATOMIC_RELAXED);
+	void (*hook)(void) = __atomic_load_n(&slot_hook, __ATOMIC_ACQUIRE);
+	uint64_t next = _time + 1;
+
+	if (hook != NULL)
+		hook();
+
+#ifdef TIMER_EVENT_DRIVEN
+	/* Nobody has work before [wake]: fast-forward to it */
+	uint64_t wake = __atomic_exchange_n(&slot_wake, TIMER_NEVER,
+					    __ATOMIC_RELAXED);
+	if (wake != TIMER_NEVER && wake > next)
+		next = wake;
+#endif
+
+	__atomic_store_n(&remaining, active, __ATOMIC_RELAXED);
+	__atomic_store_n(&_time, next, __ATOMIC_RELEASE);
+	if (active > 0)
+		printf("Time slot %3lu\n", (unsigned long)current_time());
+
+	__atomic_store_n(&sense, !sense, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&sleepers, __ATOMIC_SEQ_CST) > 0)
+		barrier_wake_all();
 }
 
 void next_slot(struct timer_id_t * timer_id) {
+	next_slot_until(timer_id, current_time() + 1);
+}
+
+void next_slot_until(struct timer_id_t * timer_id, uint64_t wake) {
+	int spin;
+
+#ifdef TIMER_EVENT_DRIVEN
+	slot_wake_min(wake);
+#else
+	(void)wake;
+#endif
+
 	/* Tell to timer that we have done our job in current slot */
-	pthread_mutex_lock(&timer_id->event_lock);
-	timer_id->done = 1;
-	pthread_cond_signal(&timer_id->event_cond);
-	pthread_mutex_unlock(&timer_id->event_lock);
-
-	/* Wait for going to next slot */
-	pthread_mutex_lock(&timer_id->timer_lock);
-	while (timer_id->done) {
-		pthread_cond_wait(
-			&timer_id->timer_cond,
-			&timer_id->timer_lock
-		);
+	timer_id->sense = !timer_id->sense;
+	if (__atomic_sub_fetch(&remaining, 1, __ATOMIC_ACQ_REL) == 0) {
+		advance_slot();
+		return;
+	}
+
+	/* Wait for going to next slot: spin briefly, then sleep */
+	for (spin = 0; spin < spin_count; spin++) {
+		if (__atomic_load_n(&sense, __ATOMIC_ACQUIRE) == timer_id->sense)
+			return;
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
 	}
-	pthread_mutex_unlock(&timer_id->timer_lock);
+
+	barrier_sleep(timer_id->sense);
+}
+
+void timer_set_slot_hook(void (*hook)(void)) {
+	__atomic_store_n(&slot_hook, hook, __ATOMIC_RELEASE);
 }
 
 uint64_t current_time() {
-	return _time;
+	return __atomic_load_n(&_time, __ATOMIC_ACQUIRE);
 }
 
 void start_timer() {
 	timer_started = 1;
-	pthread_create(&_timer, NULL, timer_routine, NULL);
+	if (sysconf(_SC_NPROCESSORS_ONLN) <= 1)
+		spin_count = 0;
+	__atomic_store_n(&remaining, n_active, __ATOMIC_RELEASE);
+	printf("Time slot %3lu\n", (unsigned long)current_time());
 }
 
 void detach_event(struct timer_id_t * event) {
-	pthread_mutex_lock(&event->event_lock);
+	if (event->fsh)
+		return;
 	event->fsh = 1;
-	pthread_cond_signal(&event->event_cond);
-	pthread_mutex_unlock(&event->event_lock);
+
+	/* Leave for good: count as arrived now and in every later slot */
+	__atomic_sub_fetch(&n_active, 1, __ATOMIC_ACQ_REL);
+	if (__atomic_sub_fetch(&remaining, 1, __ATOMIC_ACQ_REL) == 0)
+		advance_slot();
 }
 
 struct timer_id_t * attach_event() {
@@ -98,14 +169,11 @@ struct timer_id_t * attach_event() {
 	}else{
 		struct timer_id_container_t * container =
 			(struct timer_id_container_t*)malloc(
-				sizeof(struct timer_id_container_t)		
+				sizeof(struct timer_id_container_t)
 			);
-		container->id.done = 0;
 		container->id.fsh = 0;
-		pthread_cond_init(&container->id.event_cond, NULL);
-		pthread_mutex_init(&container->id.event_lock, NULL);
-		pthread_cond_init(&container->id.timer_cond, NULL);
-		pthread_mutex_init(&container->id.timer_lock, NULL);
+		container->id.sense = sense;
+		n_active++;
 		if (dev_list == NULL) {
 			dev_list = container;
 			dev_list->next = NULL;
@@ -118,19 +186,13 @@ struct timer_id_t * attach_event() {
 }
 
 void stop_timer() {
-	timer_stop = 1;
-	pthread_join(_timer, NULL);
 	while (dev_list != NULL) {
 		struct timer_id_container_t * temp = dev_list;
 		dev_list = dev_list->next;
-		pthread_cond_destroy(&temp->id.event_cond);
-		pthread_mutex_destroy(&temp->id.event_lock);
-		pthread_cond_destroy(&temp->id.timer_cond);
-		pthread_mutex_destroy(&temp->id.timer_lock);
 		free(temp);
 	}
+	timer_started = 0;
 }
 
 
 
-
@@ -0,0 +1,166 @@
+/*
+ * Per-CPU software TLB
+ * mm/tlb.c
+ */
+
+#include "tlb.h"
+#include "cpu.h"
+#include "mm.h"
+#include "os-mm.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+#if (TLB_NUM_SETS & (TLB_NUM_SETS - 1)) != 0
+#error "TLB_NUM_SETS must be a power of two"
+#endif
+
+struct tlb_t {
+	/* Taken by the owning CPU on lookup/fill and by other CPUs on
+	 * shootdown, so it is practically always uncontended */
+	pthread_mutex_t lock;
+	struct tlb_entry_t set[TLB_NUM_SETS][TLB_NUM_WAYS];
+	int next_way[TLB_NUM_SETS]; /* round-robin replacement cursor */
+};
+
+static struct tlb_t *tlbs = NULL;
+static int num_tlbs = 0;
+
+static inline int tlb_set_index(addr_t asid, addr_t pgn)
+{
+	/* asid is a frame-aligned PGD base, fold its frame number in */
+	return (int)((pgn ^ (asid >> 12)) & (TLB_NUM_SETS - 1));
+}
+
+static inline struct tlb_t *tlb_this_cpu(void)
+{
+	int cpu = cpu_current();
+
+	if (cpu < 0 || cpu >= num_tlbs)
+		return NULL;
+	return &tlbs[cpu];
+}
+
+int tlb_init(int num_cpus)
+{
+	int i;
+
+	if (num_cpus <= 0)
+		return -1;
+
+	tlbs = calloc(num_cpus, sizeof(struct tlb_t));
+	if (tlbs == NULL)
+		return -1;
+
+	for (i = 0; i < num_cpus; i++)
+		pthread_mutex_init(&tlbs[i].lock, NULL);
+
+	num_tlbs = num_cpus;
+	return 0;
+}
+
+int tlb_lookup(addr_t asid, addr_t pgn, struct tlb_entry_t *ent)
+{
+	struct tlb_t *tlb = tlb_this_cpu();
+	int way;
+
+	if (tlb == NULL)
+		return -1;
+
+	int idx = tlb_set_index(asid, pgn);
+
+	pthread_mutex_lock(&tlb->lock);
+	for (way = 0; way < TLB_NUM_WAYS; way++) {
+		struct tlb_entry_t *e = &tlb->set[idx][way];
+		if (e->valid && e->pgn == pgn && e->asid == asid) {
+			*ent = *e;
+			pthread_mutex_unlock(&tlb->lock);
+			__atomic_fetch_add(&g_paging_stats.tlb_hit, 1, __ATOMIC_RELAXED);
+			return 0;
+		}
+	}
+	pthread_mutex_unlock(&tlb->lock);
+
+	__atomic_fetch_add(&g_paging_stats.tlb_miss, 1, __ATOMIC_RELAXED);
+	return -1;
+}
+
+void tlb_insert(addr_t asid, addr_t pgn, addr_t pte_addr, uint32_t pte)
+{
+	struct tlb_t *tlb = tlb_this_cpu();
+	struct tlb_entry_t *e = NULL;
+	int way;
+
+	if (tlb == NULL)
+		return;
+
+	int idx = tlb_set_index(asid, pgn);
+
+	pthread_mutex_lock(&tlb->lock);
+
+	/* Refresh an existing entry, else take a free way, else evict */
+	for (way = 0; way < TLB_NUM_WAYS; way++) {
+		struct tlb_entry_t *cur = &tlb->set[idx][way];
+		if (cur->valid && cur->pgn == pgn && cur->asid == asid) {
+			e = cur;
+			break;
+		}
+		if (!cur->valid && e == NULL)
+			e = cur;
+	}
+
+	if (e == NULL) {
+		e = &tlb->set[idx][tlb->next_way[idx]];
+		tlb->next_way[idx] = (tlb->next_way[idx] + 1) % TLB_NUM_WAYS;
+	}
+
+	e->asid     = asid;
+	e->pgn      = pgn;
+	e->fpn      = PAGING_PTE_FPN(pte);
+	e->pte_addr = pte_addr;
+	e->valid    = 1;
+
+	pthread_mutex_unlock(&tlb->lock);
+}
+
+void tlb_invalidate(addr_t asid, addr_t pgn)
+{
+	int cpu, way;
+	int idx = tlb_set_index(asid, pgn);
+
+	for (cpu = 0; cpu < num_tlbs; cpu++) {
+		struct tlb_t *tlb = &tlbs[cpu];
+
+		pthread_mutex_lock(&tlb->lock);
+		for (way = 0; way < TLB_NUM_WAYS; way++) {
+			struct tlb_entry_t *e = &tlb->set[idx][way];
+			if (e->valid && e->pgn == pgn && e->asid == asid) {
+				e->valid = 0;
+				__atomic_fetch_add(&g_paging_stats.tlb_flush, 1,
+						   __ATOMIC_RELAXED);
+			}
+		}
+		pthread_mutex_unlock(&tlb->lock);
+	}
+}
+
+void tlb_flush_asid(addr_t asid)
+{
+	int cpu, idx, way;
+
+	for (cpu = 0; cpu < num_tlbs; cpu++) {
+		struct tlb_t *tlb = &tlbs[cpu];
+
+		pthread_mutex_lock(&tlb->lock);
+		for (idx = 0; idx < TLB_NUM_SETS; idx++) {
+			for (way = 0; way < TLB_NUM_WAYS; way++) {
+				struct tlb_entry_t *e = &tlb->set[idx][way];
+				if (e->valid && e->asid == asid) {
+					e->valid = 0;
+					__atomic_fetch_add(&g_paging_stats.tlb_flush, 1,
+							   __ATOMIC_RELAXED);
+				}
+			}
+		}
+		pthread_mutex_unlock(&tlb->lock);
+	}
+}
@@ -0,0 +1,372 @@
+
+#include "workload.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WL_PROC_DIR	"input/proc/"
+#define WL_INPUT_DIR	"input/"
+
+int workload_next(struct workload_t * wl, struct wl_arrival_t * arr) {
+	if (wl->done)
+		return 0;
+	if (wl->max_procs && wl->produced >= wl->max_procs)
+		goto exhausted;
+	if (!wl->next(wl, arr))
+		goto exhausted;
+	if (wl->max_ticks && arr->start_time >= wl->max_ticks)
+		goto exhausted;
+	wl->produced++;
+	return 1;
+
+exhausted:
+	wl->done = 1;
+	return 0;
+}
+
+void workload_close(struct workload_t * wl) {
+	if (wl != NULL)
+		wl->close(wl);
+}
+
+/*
+ * Trace source
+ */
+struct wl_trace_t {
+	struct workload_t wl;
+	FILE * file;
+	int own;
+	char dir[32];
+};
+
+static int trace_next(struct workload_t * wl, struct wl_arrival_t * arr) {
+	struct wl_trace_t * tr = (struct wl_trace_t *)wl;
+	char line[256];
+
+	while (fgets(line, sizeof(line), tr->file) != NULL) {
+		unsigned long start;
+		char prog[64];
+		long prio;
+		char * comment = strchr(line, '#');
+		int n;
+
+		if (comment != NULL)
+			*comment = '\0';
+		n = sscanf(line, "%lu %63s %ld", &start, prog, &prio);
+		if (n < 2)
+			continue;	/* blank or comment-only line */
+		if (n == 3 && (prio < 0 || prio >= MAX_PRIO)) {
+			printf("\tSkipped %s at %lu: prio %ld not in [0, %d)\n",
+			       prog, start, prio, MAX_PRIO);
+			continue;
+		}
+
+		arr->start_time = start;
+		arr->prio = (n == 3) ? prio : WL_PRIO_DEFAULT;
+		snprintf(arr->path, sizeof(arr->path), "%s%s", tr->dir, prog);
+		return 1;
+	}
+	return 0;
+}
+
+static void trace_close(struct workload_t * wl) {
+	struct wl_trace_t * tr = (struct wl_trace_t *)wl;
+
+	if (tr->own)
+		fclose(tr->file);
+	free(tr);
+}
+
+struct workload_t * workload_trace(FILE * file, const char * dir, int own) {
+	struct wl_trace_t * tr = calloc(1, sizeof(struct wl_trace_t));
+
+	if (tr == NULL)
+		return NULL;
+	tr->wl.next = trace_next;
+	tr->wl.close = trace_close;
+	tr->file = file;
+	tr->own = own;
+	snprintf(tr->dir, sizeof(tr->dir), "%s", dir);
+	return &tr->wl;
+}
+
+/*
+ * Generated sources
+ */
+struct wl_gen_t {
+	struct workload_t wl;
+	struct wl_spec_t spec;
+	uint64_t rng;
+	double clock;		/* time of the last arrival, in ticks */
+	int burst_left;		/* arrivals still due in the current burst */
+	unsigned int weight_sum;
+};
+
+/* xorshift64*, plenty for arrival processes and reproducible by seed */
+static uint64_t gen_rand(struct wl_gen_t * g) {
+	g->rng ^= g->rng >> 12;
+	g->rng ^= g->rng << 25;
+	g->rng ^= g->rng >> 27;
+	return g->rng * 0x2545F4914F6CDD1DULL;
+}
+
+/* Uniform in (0, 1] */
+static double gen_unit(struct wl_gen_t * g) {
+	return ((gen_rand(g) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+/* Exponential with mean 1/[rate] */
+static double gen_exp(struct wl_gen_t * g, double rate) {
+	return -log(gen_unit(g)) / rate;
+}
+
+static const char * gen_program(struct wl_gen_t * g) {
+	unsigned int pick = gen_rand(g) % g->weight_sum;
+	int i;
+
+	for (i = 0; i < g->spec.num_progs - 1; i++) {
+		if (pick < g->spec.weight[i])
+			break;
+		pick -= g->spec.weight[i];
+	}
+	return g->spec.prog[i];
+}
+
+static int gen_next(struct workload_t * wl, struct wl_arrival_t * arr) {
+	struct wl_gen_t * g = (struct wl_gen_t *)wl;
+	const struct wl_spec_t * sp = &g->spec;
+
+	if (sp->kind == WL_BURSTY) {
+		/* bursts arrive as a Poisson process of rate/burst, so the
+		 * mean arrival rate stays [rate] */
+		if (g->burst_left == 0) {
+			g->clock += gen_exp(g, sp->rate / sp->burst);
+			g->burst_left = sp->burst;
+		}
+		g->burst_left--;
+	} else {
+		g->clock += gen_exp(g, sp->rate);
+	}
+
+	arr->start_time = (uint64_t)g->clock;
+	snprintf(arr->path, sizeof(arr->path), "%s", gen_program(g));
+	if (sp->prio_lo == WL_PRIO_DEFAULT)
+		arr->prio = WL_PRIO_DEFAULT;
+	else
+		arr->prio = sp->prio_lo +
+			(long)(gen_rand(g) % (uint64_t)(sp->prio_hi - sp->prio_lo + 1));
+	return 1;
+}
+
+static void gen_close(struct workload_t * wl) {
+	free(wl);
+}
+
+struct workload_t * workload_open(const struct wl_spec_t * spec) {
+	struct workload_t * wl;
+
+	if (spec->kind == WL_TRACE) {
+		char path[2 * WL_PATH_LEN];
+		FILE * file;
+
+		snprintf(path, sizeof(path), "%s%s", WL_INPUT_DIR, spec->trace);
+		if ((file = fopen(path, "r")) == NULL) {
+			printf("Cannot find trace file at %s\n", path);
+			return NULL;
+		}
+		wl = workload_trace(file, WL_PROC_DIR, 1);
+		if (wl == NULL) {
+			fclose(file);
+			return NULL;
+		}
+	} else {
+		struct wl_gen_t * g = calloc(1, sizeof(struct wl_gen_t));
+		int i;
+
+		if (g == NULL)
+			return NULL;
+		g->wl.next = gen_next;
+		g->wl.close = gen_close;
+		g->spec = *spec;
+		g->rng = spec->seed ? spec->seed : 1;
+		for (i = 0; i < spec->num_progs; i++)
+			g->weight_sum += spec->weight[i];
+		wl = &g->wl;
+	}
+
+	wl->max_ticks = spec->max_ticks;
+	wl->max_procs = spec->max_procs;
+	return wl;
+}
+
+int workload_read_spec(FILE * file, const char * path,
+		       enum wl_kind_t kind, struct wl_spec_t * spec) {
+	char line[256];
+	int lineno = 1;
+
+	memset(spec, 0, sizeof(struct wl_spec_t));
+	spec->kind = kind;
+	spec->time_slot = 2;
+	spec->num_cpus = 1;
+	spec->rate = 1.0;
+	spec->burst = 8;
+	spec->seed = 1;
+	spec->prio_lo = spec->prio_hi = WL_PRIO_DEFAULT;
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char key[32], arg[64];
+		char * comment = strchr(line, '#');
+		int ok = 1;
+
+		lineno++;
+		if (comment != NULL)
+			*comment = '\0';
+		if (sscanf(line, "%31s", key) != 1)
+			continue;
+
+		if (!strcmp(key, "time_slice")) {
+			ok = sscanf(line, "%*s %d", &spec->time_slot) == 1;
+		} else if (!strcmp(key, "cpus")) {
+			ok = sscanf(line, "%*s %d", &spec->num_cpus) == 1;
+		} else if (!strcmp(key, "memsz")) {
+			unsigned long *m = spec->memsz;
+			spec->num_memsz = sscanf(line, "%*s %lu %lu %lu %lu %lu",
+						 &m[0], &m[1], &m[2], &m[3], &m[4]);
+			ok = spec->num_memsz >= 2;
+		} else if (!strcmp(key, "ticks")) {
+			ok = sscanf(line, "%*s %lu", &spec->max_ticks) == 1;
+		} else if (!strcmp(key, "procs")) {
+			ok = sscanf(line, "%*s %lu", &spec->max_procs) == 1;
+		} else if (!strcmp(key, "rate")) {
+			ok = sscanf(line, "%*s %lf", &spec->rate) == 1 &&
+			     spec->rate > 0;
+		} else if (!strcmp(key, "burst")) {
+			ok = sscanf(line, "%*s %d", &spec->burst) == 1 &&
+			     spec->burst > 0;
+		} else if (!strcmp(key, "seed")) {
+			ok = sscanf(line, "%*s %lu", &spec->seed) == 1;
+		} else if (!strcmp(key, "prio")) {
+			ok = sscanf(line, "%*s %ld %ld",
+				    &spec->prio_lo, &spec->prio_hi) == 2 &&
+			     spec->prio_lo >= 0 && spec->prio_lo <= spec->prio_hi &&
+			     spec->prio_hi < MAX_PRIO;
+		} else if (!strcmp(key, "program")) {
+			unsigned int weight = 1;
+			int n = sscanf(line, "%*s %63s %u", arg, &weight);
+
+			ok = n >= 1 && spec->num_progs < WL_MAX_PROGS && weight > 0;
+			if (ok) {
+				snprintf(spec->prog[spec->num_progs], WL_PATH_LEN,
+					 "%s%s", WL_PROC_DIR, arg);
+				spec->weight[spec->num_progs++] = weight;
+			}
+		} else if (!strcmp(key, "trace")) {
+			ok = sscanf(line, "%*s %99s", spec->trace) == 1;
+		} else if (!strcmp(key, "replace")) {
+			ok = sscanf(line, "%*s %15s", spec->replace) == 1;
+		} else if (!strcmp(key, "swap_prio")) {
+			int *p = spec->swap_prio;
+			spec->num_swap_prio = sscanf(line, "%*s %d %d %d %d",
+						     &p[0], &p[1], &p[2], &p[3]);
+			ok = spec->num_swap_prio >= 1;
+		} else {
+			printf("%s:%d: unknown workload key '%s'\n",
+			       path, lineno, key);
+			return -1;
+		}
+
+		if (!ok) {
+			printf("%s:%d: bad value for '%s'\n", path, lineno, key);
+			return -1;
+		}
+	}
+
+	if (kind == WL_TRACE && spec->trace[0] == '\0') {
+		printf("%s: trace workload without a trace file\n", path);
+		return -1;
+	}
+	if (kind != WL_TRACE && spec->num_progs == 0) {
+		printf("%s: generated workload without any program\n", path);
+		return -1;
+	}
+	if (spec->max_ticks == 0 && spec->max_procs == 0)
+		printf("%s: no ticks or procs limit, running until killed\n",
+		       path);
+	return 0;
+}
+
+/*
+ * Completion metrics
+ */
+static struct {
+	pthread_mutex_t lock;
+	uint64_t * turnaround;	/* per finished process, for percentiles */
+	uint64_t * response;
+	size_t count, cap;
+	uint64_t sum_turnaround, sum_response;
+} wl_stats = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+void wl_stats_finish(uint64_t arrival, uint64_t first_run, uint64_t now) {
+	pthread_mutex_lock(&wl_stats.lock);
+	if (wl_stats.count == wl_stats.cap) {
+		size_t cap = wl_stats.cap ? 2 * wl_stats.cap : 256;
+		uint64_t * t = realloc(wl_stats.turnaround, cap * sizeof(uint64_t));
+		uint64_t * r = t ? realloc(wl_stats.response,
+					   cap * sizeof(uint64_t)) : NULL;
+
+		if (t != NULL)
+			wl_stats.turnaround = t;
+		if (r == NULL) {
+			pthread_mutex_unlock(&wl_stats.lock);
+			return;
+		}
+		wl_stats.response = r;
+		wl_stats.cap = cap;
+	}
+	wl_stats.turnaround[wl_stats.count] = now - arrival;
+	wl_stats.response[wl_stats.count] = first_run - arrival;
+	wl_stats.count++;
+	wl_stats.sum_turnaround += now - arrival;
+	wl_stats.sum_response += first_run - arrival;
+	pthread_mutex_unlock(&wl_stats.lock);
+}
+
+static int cmp_u64(const void * a, const void * b) {
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of the sorted [v] */
+static uint64_t percentile(const uint64_t * v, size_t n, int pct) {
+	size_t rank = (n * pct + 99) / 100;
+
+	return v[rank ? rank - 1 : 0];
+}
+
+static void print_dist(const char * name, uint64_t * v, size_t n,
+		       uint64_t sum) {
+	qsort(v, n, sizeof(uint64_t), cmp_u64);
+	printf("[WORKLOAD] %s mean=%.2f p50=%lu p95=%lu p99=%lu max=%lu ticks\n",
+	       name, (double)sum / n,
+	       (unsigned long)percentile(v, n, 50),
+	       (unsigned long)percentile(v, n, 95),
+	       (unsigned long)percentile(v, n, 99),
+	       (unsigned long)v[n - 1]);
+}
+
+void wl_stats_print(uint64_t ticks, double wall_sec) {
+	size_t n = wl_stats.count;
+
+	printf("[WORKLOAD] completed=%lu ticks=%lu wall=%.3fs\n",
+	       (unsigned long)n, (unsigned long)ticks, wall_sec);
+	if (n == 0)
+		return;
+	printf("[WORKLOAD] throughput=%.4f procs/tick %.1f procs/s\n",
+	       ticks ? (double)n / ticks : 0.0,
+	       wall_sec > 0 ? n / wall_sec : 0.0);
+	print_dist("turnaround", wl_stats.turnaround, n,
+		   wl_stats.sum_turnaround);
+	print_dist("response", wl_stats.response, n, wl_stats.sum_response);
+}
@@ -0,0 +1,189 @@
+/*
+ * Compressed swap pool
+ * mm/zswap.c
+ */
+
+#include "zswap.h"
+#include "lz.h"
+#include "mm.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* Handles are swap offsets, they must fit the PTE field */
+#define ZSWAP_MAX_ENTRIES \
+	(1 << (PAGING_PTE_SWPOFF_HIBIT - PAGING_PTE_SWPOFF_LOBIT + 1))
+
+struct zs_entry {
+	BYTE *data;		/* compressed page, NULL if same-filled */
+	uint32_t len;
+	uint32_t fill;		/* word a same-filled page repeats */
+	int used;
+	int next_free;
+};
+
+static struct {
+	struct zs_entry *tbl;
+	int size;		/* entries in tbl */
+	int free;		/* first unused entry, -1 if none */
+	size_t used, cap;	/* bytes of compressed data */
+	addr_t pagesz;
+	BYTE *page, *buf;	/* a page and its compressed form */
+	pthread_mutex_t lock;
+} zs = {
+	.free = -1,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+int zswap_init(size_t size, addr_t pagesz)
+{
+	zs.page = malloc(pagesz);
+	zs.buf = malloc(pagesz);
+	if (zs.page == NULL || zs.buf == NULL) {
+		free(zs.page);
+		free(zs.buf);
+		zs.page = zs.buf = NULL;
+		return -1;
+	}
+	zs.cap = size;
+	zs.pagesz = pagesz;
+	return 0;
+}
+
+/* Take an unused entry, growing the table if needed, zs.lock held */
+static int zs_alloc_entry(void)
+{
+	int h;
+
+	if (zs.free < 0) {
+		int size = zs.size ? zs.size * 2 : 64, i;
+		struct zs_entry *tbl;
+
+		if (size > ZSWAP_MAX_ENTRIES)
+			size = ZSWAP_MAX_ENTRIES;
+		if (size == zs.size)
+			return -1;
+		tbl = realloc(zs.tbl, size * sizeof(struct zs_entry));
+		if (tbl == NULL)
+			return -1;
+		for (i = size - 1; i >= zs.size; i--) {
+			tbl[i].used = 0;
+			tbl[i].next_free = zs.free;
+			zs.free = i;
+		}
+		zs.tbl = tbl;
+		zs.size = size;
+	}
+
+	h = zs.free;
+	zs.free = zs.tbl[h].next_free;
+	zs.tbl[h].used = 1;
+	return h;
+}
+
+/* The page is one 32-bit word repeated, return it in [fill] */
+static int same_filled(const BYTE *page, addr_t pagesz, uint32_t *fill)
+{
+	uint32_t first, w;
+	addr_t i;
+
+	memcpy(&first, page, sizeof(first));
+	for (i = sizeof(w); i < pagesz; i += sizeof(w)) {
+		memcpy(&w, page + i, sizeof(w));
+		if (w != first)
+			return 0;
+	}
+	*fill = first;
+	return 1;
+}
+
+int zswap_store(struct memphy_struct *mram, addr_t fpn, addr_t *handle)
+{
+	BYTE *data = NULL;
+	uint32_t fill = 0;
+	int clen = 0, h;
+
+	if (zs.page == NULL || mram->pagesz != (int)zs.pagesz)
+		return -1;
+
+	pthread_mutex_lock(&zs.lock);
+	if (MEMPHY_read_frame(mram, fpn, zs.page) != 0)
+		goto reject;
+
+	if (!same_filled(zs.page, zs.pagesz, &fill)) {
+		/* Not worth it for less than a quarter saved */
+		clen = lz_compress(zs.page, zs.pagesz, zs.buf,
+				   zs.pagesz * 3 / 4);
+		if (clen < 0 || zs.used + clen > zs.cap)
+			goto reject;
+		data = malloc(clen);
+		if (data == NULL)
+			goto reject;
+		memcpy(data, zs.buf, clen);
+	}
+
+	h = zs_alloc_entry();
+	if (h < 0) {
+		free(data);
+		goto reject;
+	}
+	zs.tbl[h].data = data;
+	zs.tbl[h].len = clen;
+	zs.tbl[h].fill = fill;
+	zs.used += clen;
+
+	if (data == NULL)
+		g_paging_stats.zswap_same_filled++;
+	else
+		g_paging_stats.zswap_stored++;
+	pthread_mutex_unlock(&zs.lock);
+
+	*handle = h;
+	return 0;
+
+reject:
+	g_paging_stats.zswap_reject++;
+	pthread_mutex_unlock(&zs.lock);
+	return -1;
+}
+
+int zswap_load(addr_t handle, struct memphy_struct *mram, addr_t fpn)
+{
+	struct zs_entry *e;
+	int rc = -1;
+
+	pthread_mutex_lock(&zs.lock);
+	if (handle >= (addr_t)zs.size || !zs.tbl[handle].used)
+		goto out;
+	e = &zs.tbl[handle];
+
+	if (e->data == NULL) {
+		addr_t i;
+
+		for (i = 0; i < zs.pagesz; i += sizeof(e->fill))
+			memcpy(zs.page + i, &e->fill, sizeof(e->fill));
+	} else if (lz_decompress(e->data, e->len, zs.page,
+				 zs.pagesz) != (int)zs.pagesz) {
+		goto out;
+	}
+	rc = MEMPHY_write_frame(mram, fpn, zs.page);
+out:
+	pthread_mutex_unlock(&zs.lock);
+	return rc;
+}
+
+void zswap_free(addr_t handle)
+{
+	struct zs_entry *e;
+
+	pthread_mutex_lock(&zs.lock);
+	if (handle < (addr_t)zs.size && zs.tbl[handle].used) {
+		e = &zs.tbl[handle];
+		free(e->data);
+		zs.used -= e->len;
+		e->used = 0;
+		e->next_free = zs.free;
+		zs.free = handle;
+	}
+	pthread_mutex_unlock(&zs.lock);
+}